@@ -16,4 +16,9 @@
 #include <unordered_map>
 
 //Windows dependend
-#include <Windows.h>h>
\ No newline at end of file
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
\ No newline at end of file
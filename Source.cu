@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "GL/glew.h"
 #include <GLFW/glfw3.h>
+#include <chrono>
 
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_opengl3.h>
@@ -10,123 +11,339 @@
 #include "src/Rendering/VertexBufferLayout.h"
 #include "src/Rendering/IndexBuffer.h"
 #include "src/Rendering/Texture.h"
+#include "src/Rendering/PixelBufferRing.h"
 #include "src/Utils/Utils.h"
+#include "src/Utils/CudaErrors.h"
 #include "src/Raytracing/HittableList.h"
+#include "src/Raytracing/Scene.h"
 #include "src/Raytracing/Objects/Sphere.h"
 #include "src/Camera.h"
-#include "src/Raytracing/Materials/Lambertian.h"
-#include "src/Raytracing/Materials/Metal.h"
-#include "src/Raytracing/Materials/Dielectric.h"
-
-//CUDA
-#include <curand_kernel.h>
-#include <device_launch_parameters.h>
+#include "src/Raytracing/Materials/MaterialTable.h"
+#include "src/Backends/CpuRenderer.h"
+#include "src/Backends/CudaRenderer.h"
+#include "src/Backends/WavefrontCpuRenderer.h"
+#include "src/Backends/WavefrontCudaRenderer.h"
+#include "src/Utils/CommandLine.h"
+#include "src/Utils/ImageWriter.h"
+#include "src/Utils/ObjLoader.h"
+#include "src/Benchmarks/Microbenchmarks.h"
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-// limited version of checkCudaErrors from helper_cuda.h in CUDA examples
-#define checkCudaErrors(val) check_cuda( (val), #val, __FILE__, __LINE__ )
+Camera createCamera(const RenderOptions& options)
+{
+    float aspectRatio = float(options.imageSize.x) / options.imageSize.y;
+    Camera cam(glm::vec3(13, 2, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0), 20, 10.0, 0.6, aspectRatio, options.imageSize.x,
+        options.samplesPerPixel, options.maxDepth);
+    cam.setRouletteDepth(options.rouletteDepth);
+    cam.setSampler(options.sampler == "sobol" ? Utils::Sampler::Sobol : Utils::Sampler::Independent);
+    return cam;
+}
+
+//centerSphere false - the middle glass sphere makes room for a mesh
+void buildWorld(Scene& scene, bool centerSphere)
+{
+    std::mt19937 gen(1984);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    auto random = [&](float a, float b) { return a + dist(gen) * (b - a); };
+    auto randomVector = [&](float a, float b) { return glm::vec3(random(a, b), random(a, b), random(a, b)); };
+
+    scene.addSphere(glm::vec3(0, -1000.0f, -1), 1000.0f, scene.addMaterial(MaterialData::lambertian(glm::vec3(0.5f, 0.5f, 0.5f))));
+
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            float choose_mat = random(0.0f, 1.0f);
+            glm::vec3 center(a + 0.9f * random(0.0f, 1.0f), 0.2f, b + 0.9f * random(0.0f, 1.0f));
+
+            if (glm::length(center - glm::vec3(4, 0.2, 0)) > 0.9f) {
+                MaterialData sphere_material;
+
+                if (choose_mat < 0.8f) {
+                    glm::vec3 albedo = randomVector(0.0f, 1.0f) * randomVector(0.0f, 1.0f);
+                    sphere_material = MaterialData::lambertian(albedo);
+                }
+                else if (choose_mat < 0.95f) {
+                    glm::vec3 albedo = randomVector(0.5f, 1.0f);
+                    float fuzz = random(0.0f, 0.5f);
+                    sphere_material = MaterialData::metal(albedo, fuzz);
+                }
+                else
+                    sphere_material = MaterialData::dielectric(1.5f);
 
-void check_cuda(cudaError_t result, char const* const func, const char* const file, int const line) {
-    if (result) {
-        std::cerr << "CUDA error = " << static_cast<unsigned int>(result) << " at " <<
-            file << ":" << line << " '" << func << "' \n";
-        cudaError_t err = cudaGetLastError();
-        if (err != cudaSuccess) {
-            printf("CUDA Error: %s\n", cudaGetErrorString(err));
+                scene.addSphere(center, 0.2f, scene.addMaterial(sphere_material));
+            }
         }
-        // Make sure we call CUDA Device Reset before exiting
-        cudaDeviceReset();
-        exit(99);
     }
+    if (centerSphere)
+        scene.addSphere(glm::vec3(0, 1, 0), 1.0f, scene.addMaterial(MaterialData::dielectric(1.5f)));
+    scene.addSphere(glm::vec3(-4, 1, 0), 1.0f, scene.addMaterial(MaterialData::lambertian(glm::vec3(0.4f, 0.2f, 0.1f))));
+    scene.addSphere(glm::vec3(4, 1, 0), 1.0f, scene.addMaterial(MaterialData::metal(glm::vec3(0.7f, 0.6f, 0.5f), 0.0f)));
 }
 
-__global__ void render_init(glm::u32vec2 imgSize, curandState* rand_state) {
-    int i = threadIdx.x + blockIdx.x * blockDim.x;
-    int j = threadIdx.y + blockIdx.y * blockDim.y;
-
-    if ((i >= imgSize.x) || (j >= imgSize.y))
-        return;
-    int pixel_index = j * imgSize.x + i;
-    curand_init(1984 + pixel_index, 0, 0, &rand_state[pixel_index]);
+//One geometry, the full size copy in the middle and count small ones on the ground around it
+void addInstances(Scene& scene, const TriangleMesh& mesh, uint32_t materialId, uint32_t count)
+{
+    auto start = std::chrono::steady_clock::now();
+    BVHBuilder builder;
+    uint32_t geometryId = scene.addGeometry(mesh, builder);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Geometry: " << mesh.getTrianglesCount() << " triangles, " << builder.getNodes().size() << " BVH nodes (built in " << seconds << " s)\n";
+
+    scene.addInstance(geometryId, glm::mat4(1.0f), materialId);
+
+    std::mt19937 gen(2024);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    auto random = [&](float a, float b) { return a + dist(gen) * (b - a); };
+
+    uint32_t materials[8];
+    for (uint32_t& material : materials)
+        material = scene.addMaterial(MaterialData::lambertian(glm::vec3(random(0.1f, 0.9f), random(0.1f, 0.9f), random(0.1f, 0.9f))));
+
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 position(random(-11.0f, 11.0f), 0.0f, random(-11.0f, 11.0f));
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+        transform = glm::rotate(transform, random(0.0f, 2.0f * Utils::pi), glm::vec3(0.0f, 1.0f, 0.0f));
+        transform = glm::scale(transform, glm::vec3(random(0.1f, 0.25f)));
+        scene.addInstance(geometryId, transform, materials[i % 8]);
+    }
 }
 
-__global__ void render(dataPixels* data, glm::u32vec2 imgSize, Camera** cam, Hittable** world, curandState* rand_state)
+//Everything buildScene depends on: FNV-1a over the options and the mesh file size and time, so an edited mesh rebuilds
+uint64_t sceneCacheKey(const RenderOptions& options)
 {
-    int i = threadIdx.x + blockIdx.x * blockDim.x;
-    int j = threadIdx.y + blockIdx.y * blockDim.y;
+    std::string description = options.mesh + "|" + std::to_string(options.instances) + "|" + options.builder;
+    if (!options.mesh.empty()) {
+        std::error_code error;
+        uintmax_t size = std::filesystem::file_size(options.mesh, error);
+        auto time = std::filesystem::last_write_time(options.mesh, error);
+        description += "|" + std::to_string(error ? 0 : size) + "|" + std::to_string(error ? 0 : time.time_since_epoch().count());
+    }
 
-    if ((i >= imgSize.x) || (j >= imgSize.y))
-        return;
-    
-    int pixelIndex = i + j * imgSize.x;
-    curandState localRandState = rand_state[pixelIndex];
-    glm::vec3 pixelColor(0.0f, 0.0f, 0.0f);
-    for (int sampleIdx = 0; sampleIdx < (*cam)->getPerPixelSamples(); sampleIdx++){
-        Ray r = (*cam)->getRay(i, j, &localRandState);
-        pixelColor += (*cam)->rayColor(r, (*cam)->getMaxRecursionDepth(), world, &localRandState);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (char c : description) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ull;
     }
-    rand_state[pixelIndex] = localRandState;
-    data[pixelIndex] = (*cam)->convertColor((*cam)->getPixelSampleScale() * pixelColor);
+    return hash;
 }
 
-__global__ void rand_init(curandState* rand_state) {
-    if (threadIdx.x == 0 && blockIdx.x == 0) {
-        curand_init(1984, 0, 0, rand_state);
+//false when options.mesh can't be loaded
+bool buildScene(Scene& scene, const RenderOptions& options)
+{
+    uint64_t cacheKey = 0;
+    if (!options.sceneCache.empty()) {
+        cacheKey = sceneCacheKey(options);
+        auto start = std::chrono::steady_clock::now();
+        if (scene.loadCache(options.sceneCache, cacheKey)) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cerr << "Scene: " << scene.getSpheresCount() << " spheres, " << scene.getTrianglesCount() << " triangles, "
+                << scene.getInstancesCount() << " instances, " << scene.getNodesCount() << " BVH nodes (loaded from "
+                << options.sceneCache << " in " << seconds << " s)\n";
+            return true;
+        }
     }
-}
 
-#define RND (curand_uniform(&local_rand_state))
+    //Scene is built on host and uploaded with a single copy
+    buildWorld(scene, options.mesh.empty());
+    if (!options.mesh.empty()) {
+        TriangleMesh mesh;
+        auto start = std::chrono::steady_clock::now();
+        if (!ObjLoader::load(options.mesh, mesh))
+            return false;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Loaded " << options.mesh << ": " << mesh.getTrianglesCount() << " triangles, " << mesh.getVerticesCount() << " vertices in "
+            << seconds << " s\n";
+
+        //Stands where the glass sphere was
+        mesh.fit(glm::vec3(0.0f, 0.0f, 0.0f), 2.0f);
+        uint32_t materialId = scene.addMaterial(MaterialData::lambertian(glm::vec3(0.6f, 0.6f, 0.6f)));
+        if (options.instances == 0)
+            scene.addMesh(mesh, materialId);
+        else
+            addInstances(scene, mesh, materialId, options.instances);
+    }
 
-__global__ void initCamera(Camera** camera, glm::u32vec2 imgSize)
+    auto start = std::chrono::steady_clock::now();
+    int depth;
+    if (options.builder == "lbvh") {
+        LBVHBuilder builder(options.threads);
+        scene.buildBVH(builder);
+        depth = builder.getDepth();
+    }
+    else {
+        BVHBuilder builder;
+        scene.buildBVH(builder);
+        depth = builder.getDepth();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Scene: " << scene.getSpheresCount() << " spheres, " << scene.getTrianglesCount() << " triangles, " << scene.getInstancesCount()
+        << " instances, " << scene.getNodesCount() << " " << options.builder << " BVH nodes (depth " << depth << ", SAH cost "
+        << BVHBuilder::sahCost(scene.getNodes()) << ", built in " << seconds << " s)\n";
+
+    if (!options.sceneCache.empty()) {
+        start = std::chrono::steady_clock::now();
+        if (scene.saveCache(options.sceneCache, cacheKey)) {
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cerr << "Saved " << options.sceneCache << " in " << seconds << " s\n";
+        }
+        else
+            std::cerr << "Failed to write " << options.sceneCache << "\n";
+    }
+    return true;
+}
+
+//nullptr when the requested backend can't run here
+std::unique_ptr<RenderBackend> createBackend(Scene& scene, const Camera& cam, const RenderOptions& options)
 {
-    *camera = new Camera(glm::vec3(13, 2, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0), 20, 10.0, 0.6, 16.0f / 9.0f, imgSize.x, 100, 50);
+    bool cudaAvailable = CudaRenderer::isAvailable();
+    if (options.backend == "cuda" && !cudaAvailable) {
+        std::cout << "No CUDA device available" << std::endl;
+        return nullptr;
+    }
+
+    //Without a CUDA device the same scene is rendered on CPU threads
+    bool wavefront = options.integrator == "wavefront";
+    Wavefront::SortMode sortMode = Wavefront::SortMode::None;
+    if (options.sort == "material")
+        sortMode = Wavefront::SortMode::Material;
+    else if (options.sort == "octant")
+        sortMode = Wavefront::SortMode::MaterialOctant;
+
+    std::unique_ptr<RenderBackend> backend;
+    if (options.backend == "cpu" || !cudaAvailable) {
+        if (wavefront)
+            backend = std::make_unique<WavefrontCpuRenderer>(scene, cam, options.threads, sortMode);
+        else
+            backend = std::make_unique<CpuRenderer>(scene, cam, options.threads);
+    }
+    else if (wavefront)
+        backend = std::make_unique<WavefrontCudaRenderer>(scene, cam, sortMode);
+    else
+        backend = std::make_unique<CudaRenderer>(scene, cam);
+    std::cerr << "Rendering on " << backend->getName() << "\n";
+    return backend;
 }
 
-__global__ void initWorld(Hittable** worldObjects, Hittable** listObjects, curandState* rand_state)
+//Stage times (host pipeline only) and how much sorting cut the materials mixed inside a warp
+void printWavefrontStats(const RenderBackend& backend)
 {
-    if (threadIdx.x != 0 || blockIdx.x != 0)
+    const Wavefront::Stats* stats = nullptr;
+    if (const WavefrontCpuRenderer* cpu = dynamic_cast<const WavefrontCpuRenderer*>(&backend)) {
+        stats = &cpu->getStats();
+        std::cerr << "Stages: generate " << stats->generate << " s, intersect " << stats->intersect << " s, sort " << stats->sort
+            << " s, shade " << stats->shade << " s, compact " << stats->compact << " s\n";
+    }
+    else if (const WavefrontCudaRenderer* cuda = dynamic_cast<const WavefrontCudaRenderer*>(&backend))
+        stats = &cuda->getStats();
+
+    if (!stats)
         return;
 
-    int id = 0;
-    curandState local_rand_state = *rand_state;
-    listObjects[id++] = new Sphere(glm::vec3(0, -1000.0f, -1), 1000.0f, new Materials::Lambertian(glm::vec3(0.5f, 0.5f, 0.5f)));
+    std::cerr << stats->pathsShaded << " path segments shaded\n";
+    if (stats->sortedGroups > 0)
+        std::cerr << "Materials per " << Wavefront::warpSize << " paths: " << double(stats->materialsBeforeSort) / stats->sortedGroups
+            << " unsorted, " << double(stats->materialsAfterSort) / stats->sortedGroups << " sorted\n";
+}
+
+//Batch mode for machines without a display, no GLFW / GLEW / ImGui at all
+int renderHeadless(const RenderOptions& options)
+{
+    Camera cam = createCamera(options);
+    glm::u32vec2 imgSize = cam.getImageSize();
 
-    for (int a = -11; a < 11; a++) {
-        for (int b = -11; b < 11; b++) {
-            double choose_mat = Utils::generateRandomNumber(&local_rand_state);
-            glm::vec3 center(a + 0.9 * Utils::generateRandomNumber(&local_rand_state), 0.2, b + 0.9 * Utils::generateRandomNumber(&local_rand_state));
+    Scene scene;
+    if (!buildScene(scene, options))
+        return -1;
+    std::unique_ptr<RenderBackend> backend = createBackend(scene, cam, options);
+    if (!backend)
+        return -1;
 
-            if ((center - glm::vec3(4, 0.2, 0)).length() > 0.9) {
-                Material* sphere_material;
+    std::vector<dataPixels> pixels(imgSize.x * imgSize.y);
 
-                if (choose_mat < 0.8) {
-                    glm::vec3 albedo = Utils::Vector::randomVector(0.0, 1.0, &local_rand_state) * Utils::Vector::randomVector(0.0, 1.0, &local_rand_state);
-                    sphere_material = new Materials::Lambertian(albedo);
-                }
-                else if (choose_mat < 0.95) {
-                    glm::vec3 albedo = Utils::Vector::randomVector(0.5, 1.0, &local_rand_state);
-                    double fuzz = Utils::generateRandomNumber(0, 0.5, &local_rand_state);
-                    sphere_material = new Materials::Metal(albedo, fuzz);
-                }
-                else
-                    sphere_material = new Materials::Dielectric(1.5);
+    Adaptive::Settings adaptive;
+    adaptive.threshold = options.adaptiveThreshold;
+    uint64_t samplesTaken = uint64_t(imgSize.x) * imgSize.y * cam.getPerPixelSamples();
 
-                listObjects[id++] = new Sphere(center, 0.2, sphere_material);
-            }
-        }
-    }
-    listObjects[id++] = new Sphere(glm::vec3(0, 1, 0), 1.0, new Materials::Dielectric(1.5f));
-    listObjects[id++] = new Sphere(glm::vec3(-4, 1, 0), 1.0, new Materials::Lambertian(glm::vec3(0.4f, 0.2f, 0.1f)));
-    listObjects[id++] = new Sphere(glm::vec3(4, 1, 0), 1.0, new Materials::Metal(glm::vec3(0.7f, 0.6f, 0.5f), 0.0f));
-    *rand_state = local_rand_state;
-    *worldObjects = new HittableList(listObjects, 22 * 22 + 1 + 3);
+    auto start = std::chrono::steady_clock::now();
+    if (options.adaptiveThreshold > 0.0f)
+        samplesTaken = backend->renderAdaptive(adaptive, pixels.data());
+    else
+        backend->render(pixels.data());
+    auto stop = std::chrono::steady_clock::now();
+
+    double timer_seconds = std::chrono::duration<double>(stop - start).count();
+    std::cerr << imgSize.x << "x" << imgSize.y << ", " << double(samplesTaken) / (imgSize.x * imgSize.y) << " spp"
+        << (options.adaptiveThreshold > 0.0f ? " (adaptive)" : "") << " took " << timer_seconds << " seconds (" << backend->getName() << ").\n";
+
+    printWavefrontStats(*backend);
+
+    std::vector<glm::vec3> radiance(imgSize.x * imgSize.y);
+    backend->readRadiance(radiance.data());
+    if (!ImageWriter::write(options.output, (unsigned char*)pixels.data(), radiance.data(), imgSize.x, imgSize.y))
+        return -1;
+
+    std::cerr << "Saved " << options.output << "\n";
+    return 0;
 }
 
-__global__ void freeWorld(Hittable** worldObjects, Camera** camera) {
-    delete *worldObjects;
-    delete *camera;
+//Host microbenchmarks on the same scene and camera as a render, results go to stdout. Fails (-1) when a correctness
+//check does, after every benchmark has printed
+int runBenchmarks(const RenderOptions& options)
+{
+    Camera cam = createCamera(options);
+    Scene scene;
+    if (!buildScene(scene, options))
+        return -1;
+
+    std::cout << "Microbenchmarks: " << options.benchmarkRays << " rays, " << cam.getImageSize().x << "x" << cam.getImageSize().y
+        << " camera\n";
+    std::vector<Microbenchmarks::Result> results = Microbenchmarks::run(scene, cam, options.benchmarkRays);
+    Microbenchmarks::print(results);
+
+    //Whole renders are slow, the roulette check uses a small image
+    RenderOptions rouletteOptions = options;
+    rouletteOptions.imageSize = glm::u32vec2(320, 180);
+    rouletteOptions.samplesPerPixel = 32;
+    if (rouletteOptions.rouletteDepth == 0)
+        rouletteOptions.rouletteDepth = RenderOptions().rouletteDepth;
+    Microbenchmarks::RouletteComparison roulette = Microbenchmarks::compareRoulette(scene, createCamera(rouletteOptions), options.threads);
+    Microbenchmarks::print(roulette);
+
+    RenderOptions adaptiveOptions = rouletteOptions;
+    adaptiveOptions.imageSize = glm::u32vec2(160, 90);
+    Adaptive::Settings adaptive;
+    if (options.adaptiveThreshold > 0.0f)
+        adaptive.threshold = options.adaptiveThreshold;
+    Camera convergenceCam = createCamera(adaptiveOptions);
+    Microbenchmarks::Reference reference = Microbenchmarks::renderReference(scene, convergenceCam, 512, options.threads);
+    Microbenchmarks::print(Microbenchmarks::compareAdaptive(scene, convergenceCam, adaptive, reference, options.threads));
+    Microbenchmarks::print(Microbenchmarks::compareSamplers(scene, convergenceCam, reference, options.threads));
+
+    Microbenchmarks::print(Microbenchmarks::compareBuilders({ 10000, 100000, 1000000 }, options.benchmarkRays, options.threads));
+    Microbenchmarks::print(Microbenchmarks::compareRefit(100000, 60, options.benchmarkRays, options.threads));
+    std::vector<Microbenchmarks::WideResult> widths = Microbenchmarks::compareWidths({ 100000, 1000000 }, options.benchmarkRays);
+    Microbenchmarks::print(widths);
+
+    bool passed = true;
+    for (const Microbenchmarks::Result& result : results) {
+        if (result.mismatches > 0) {
+            std::cerr << "FAIL: " << result.mismatches << " rays of " << result.name << " differ from HittableList::hit\n";
+            passed = false;
+        }
+    }
+    if (!roulette.unbiased()) {
+        std::cerr << "FAIL: Russian roulette changed the mean radiance\n";
+        passed = false;
+    }
+    for (const Microbenchmarks::WideResult& result : widths) {
+        if (result.missedHits > 0) {
+            std::cerr << "FAIL: " << result.missedHits << " rays missed the closest hit in the " << result.width << " wide "
+                << (result.quantized ? "8 bit" : "float") << " tree over " << result.primitivesCount << " spheres\n";
+            passed = false;
+        }
+    }
+    return passed ? 0 : -1;
 }
 
 void processInput(GLFWwindow* window)
@@ -145,8 +362,17 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     glViewport(0, 0, width, height);
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    RenderOptions options;
+    if (!parseCommandLine(argc, argv, options))
+        return -1;
+
+    if (options.benchmark)
+        return runBenchmarks(options);
+    if (options.headless)
+        return renderHeadless(options);
+
     if (!glfwInit())
     {
         std::cout << "Failed to initialize glfwInit()" << std::endl;
@@ -158,20 +384,15 @@ int main()
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     //Essential window calculations
-    curandState* curRandState1; //For world creation
-    checkCudaErrors(cudaMalloc((void**)&curRandState1, 1 * sizeof(curandState)));
-    rand_init<<<1, 1>>>(curRandState1);
-    checkCudaErrors(cudaGetLastError());
-    checkCudaErrors(cudaDeviceSynchronize());
+    Camera cam = createCamera(options);
+    glm::u32vec2 imgSize = cam.getImageSize(); //imGuiCam.getImageSize();
 
-    glm::u32vec2 imgTmp(1920, 1920);
-    Camera** cam;
-    checkCudaErrors(cudaMalloc((void**)&cam, sizeof(Camera*)));
-    initCamera<<<1, 1 >>>(cam, imgTmp);
-    checkCudaErrors(cudaGetLastError());
-    checkCudaErrors(cudaDeviceSynchronize());
-
-    glm::u32vec2 imgSize = glm::u32vec2(imgTmp.x, imgTmp.x / (16.0f / 9.0f)); //imGuiCam.getImageSize();
+    //Progressive - a few samples per frame straight into the window, otherwise one blocking render
+    bool progressive = true;
+    int samplesPerFrame = 1;
+    //Applied by the display shader to the linear accumulation, changing them never touches the renderer
+    float exposure = 0.0f;
+    int toneMapping = 0;
 
     GLFWwindow* window = glfwCreateWindow(imgSize.x, imgSize.y, "Raytracing", NULL, NULL);
     if (window == NULL)
@@ -205,50 +426,31 @@ int main()
     Shader sh("src/Rendering/Shaders/shader.shader");
 
     //RAYTRACING CODE
-    //To tutaj bo nie chce mi sie liczyc ile to bd :)
-    int hittableCount = 1;
-    for (int a = -11; a < 11; a++)
-        for (int b = -11; b < 11; b++)
-            hittableCount++;
-
-    Hittable** hittableList;
-    checkCudaErrors(cudaMalloc((void**)&hittableList, hittableCount * sizeof(Hittable*)));
-    Hittable** world;
-    checkCudaErrors(cudaMalloc((void**)&world, sizeof(Hittable*)));
-
-    //Allocate randState
-    uint32_t numOfChannels = 4; //RGBA
-    uint32_t pixelsSize = imgSize.x * imgSize.y * numOfChannels;
-
-    curandState* curRandState; //For pixels
-    checkCudaErrors(cudaMalloc((void**)&curRandState, pixelsSize * sizeof(curandState)));
-    initWorld<<<1, 1>>>(world, hittableList, curRandState1);
-    checkCudaErrors(cudaGetLastError());
-    checkCudaErrors(cudaDeviceSynchronize());
-
-    dataPixels* pixels;
-    checkCudaErrors(cudaMallocManaged((void**)&pixels, pixelsSize * sizeof(dataPixels)));
-
-    clock_t start, stop;
-    start = clock();
-
-    // Render our buffer
-    int threadsX = 8, threadsY = 8;
-    dim3 blocks(imgSize.x / threadsX + 1, imgSize.y / threadsY + 1);
-    dim3 threads(threadsX, threadsY);
-    render_init<<<blocks, threads>>>(imgSize, curRandState);
-    checkCudaErrors(cudaGetLastError());
-    checkCudaErrors(cudaDeviceSynchronize());
-    render<<<blocks, threads>>>(pixels, imgSize, cam, world, curRandState);
-    checkCudaErrors(cudaGetLastError());
-    checkCudaErrors(cudaDeviceSynchronize());
-
-    stop = clock();
-    double timer_seconds = ((double)(stop - start)) / CLOCKS_PER_SEC;
-    std::cerr << "took " << timer_seconds << " seconds.\n";
+    Scene scene;
+    if (!buildScene(scene, options))
+        return -1;
+    std::unique_ptr<RenderBackend> backend = createBackend(scene, cam, options);
+    if (!backend)
+        return -1;
+
+    //The window shows the renderer's linear accumulation buffer, 8 bit pixels are only made for image files
+    std::vector<glm::vec4> accumulation(imgSize.x * imgSize.y);
+
+    if (!progressive) {
+        auto start = std::chrono::steady_clock::now();
+        backend->render(nullptr);
+        auto stop = std::chrono::steady_clock::now();
+        backend->readAccumulation(accumulation.data());
+
+        double timer_seconds = std::chrono::duration<double>(stop - start).count();
+        std::cerr << "took " << timer_seconds << " seconds (" << backend->getName() << ").\n";
+    }
 
     //Texture generation
-    Texture tx((unsigned char*)pixels, imgSize.x, imgSize.y);
+    Texture tx(reinterpret_cast<const float*>(accumulation.data()), imgSize.x, imgSize.y);
+    //Progressive frames are copied straight into mapped buffers and reach the texture asynchronously
+    PixelBufferRing pixelBuffers(imgSize.x, imgSize.y, sizeof(glm::vec4));
+    bool usePixelBuffers = true;
 
     //DRAWING utils and preparations
     glm::vec2 size(1.0f, 1.0f);
@@ -277,6 +479,7 @@ int main()
     Renderer renderer;
     sh.unbind();
 
+    double frameSeconds = 0.0, totalSeconds = 0.0, samplesPerSecond = 0.0, uploadSeconds = 0.0;
     while (!glfwWindowShouldClose(window))
     {
         float currFrame = static_cast<float>(glfwGetTime());
@@ -294,8 +497,63 @@ int main()
         //ImGui::ShowDemoWindow();
 
         processInput(window);
+
+        if (progressive) {
+            //Keep adding samples until the camera sample count is reached
+            uint32_t targetSamples = cam.getPerPixelSamples();
+            if (backend->getAccumulatedSamples() < targetSamples) {
+                uint32_t samples = std::min<uint32_t>(samplesPerFrame, targetSamples - backend->getAccumulatedSamples());
+
+                auto start = std::chrono::steady_clock::now();
+                backend->accumulate(samples, nullptr);
+                auto stop = std::chrono::steady_clock::now();
+
+                //Upload time is the wait for a free buffer, the accumulation read into it and the upload call
+                auto uploadStart = std::chrono::steady_clock::now();
+                void* mapped = usePixelBuffers ? pixelBuffers.map() : nullptr;
+                if (usePixelBuffers && !mapped) {
+                    std::cerr << "Pixel buffer could not be mapped, uploading synchronously\n";
+                    usePixelBuffers = false;
+                }
+                if (mapped) {
+                    backend->readAccumulation(static_cast<glm::vec4*>(mapped));
+                    pixelBuffers.upload(tx);
+                }
+                else {
+                    backend->readAccumulation(accumulation.data());
+                    tx.updateData(accumulation.data());
+                }
+                uploadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - uploadStart).count();
+
+                frameSeconds = std::chrono::duration<double>(stop - start).count();
+                totalSeconds += frameSeconds;
+                samplesPerSecond = double(imgSize.x) * imgSize.y * samples / frameSeconds;
+                if (backend->getAccumulatedSamples() == targetSamples)
+                    std::cerr << "took " << totalSeconds << " seconds (" << backend->getName() << ", progressive).\n";
+            }
+
+            ImGui::Begin("Progressive");
+            ImGui::Text("%s: %u / %u spp", backend->getName(), backend->getAccumulatedSamples(), targetSamples);
+            ImGui::Text("%.2f Msamples/s, %.1f ms/frame", samplesPerSecond / 1e6, frameSeconds * 1e3);
+            ImGui::Text("Upload %.2f ms/frame", uploadSeconds * 1e3);
+            ImGui::SliderInt("Samples per frame", &samplesPerFrame, 1, 16);
+            ImGui::Checkbox(pixelBuffers.isPersistent() ? "Persistent pixel buffers" : "Pixel buffers", &usePixelBuffers);
+            if (ImGui::Button("Restart")) {
+                backend->resetAccumulation();
+                totalSeconds = 0.0;
+            }
+            ImGui::End();
+        }
+
+        ImGui::Begin("Display");
+        ImGui::SliderFloat("Exposure (stops)", &exposure, -8.0f, 8.0f);
+        ImGui::Combo("Tone mapping", &toneMapping, "Clamp\0Reinhard\0ACES\0");
+        ImGui::End();
+
         sh.bind();
         sh.setUniform1i("texture1", 0);
+        sh.setUniform1f("exposure", exposure);
+        sh.setUniform1i("toneMapping", toneMapping);
         tx.bind(0);
 
         renderer.draw(va, ib, sh);
@@ -0,0 +1,64 @@
+#pragma once
+#include "../Camera.h"
+
+//Adaptive sampling. Next to its accumulation entry every pixel keeps the sum of squared sample luminance,
+//so the standard error of its mean is known after every round. Pixels under the threshold stop taking
+//samples and the rest of the budget goes to the ones that are still noisy. Shared by CpuRenderer and CudaRenderer
+namespace Adaptive
+{
+	//Floor of the mean the error is relative to, dark pixels would otherwise never converge
+	constexpr float darkLuminance = 0.1f;
+
+	struct Settings {
+		float threshold = 0.02f; //Relative standard error of the mean luminance a pixel stops at
+		uint32_t samplesPerPixel = 0; //Average budget, 0 - camera samples per pixel
+		uint32_t minSamples = 8; //Taken by every pixel before the first estimate
+		uint32_t maxSamples = 0; //Per pixel cap, 0 - 8x the average budget
+		uint32_t batchSamples = 4; //Per round by every noisy pixel
+	};
+
+	//acc as in RenderBackend (rgb - sum, w - samples count)
+	__host__ __device__ inline float relativeError(const glm::vec4& acc, float luminanceSquares)
+	{
+		if (acc.w < 2.0f)
+			return Utils::infinity;
+
+		float mean = Utils::luminance(glm::vec3(acc)) / acc.w;
+		float variance = fmaxf(luminanceSquares / acc.w - mean * mean, 0.0f) * acc.w / (acc.w - 1.0f);
+		return sqrtf(variance / acc.w) / fmaxf(mean, darkLuminance);
+	}
+
+	//Samples the pixel takes this round, 0 - converged or at the cap
+	__host__ __device__ inline uint32_t samplesToTake(const glm::vec4& acc, float luminanceSquares, uint32_t samplesCount, const Settings& settings)
+	{
+		uint32_t taken = uint32_t(acc.w);
+		if (taken >= settings.maxSamples)
+			return 0;
+		if (taken >= settings.minSamples && relativeError(acc, luminanceSquares) < settings.threshold)
+			return 0;
+
+		uint32_t left = settings.maxSamples - taken;
+		return samplesCount < left ? samplesCount : left;
+	}
+
+	//One round of pixel (i, j), returns the samples taken. Sample indices continue from the pixel's own count,
+	//so the first n samples of a pixel are the same as in a uniform render
+	template<typename MaterialDispatch>
+	__host__ __device__ inline uint32_t accumulatePixel(uint32_t i, uint32_t j, const Camera& cam, uint32_t samplesCount, const Settings& settings,
+		Hittable** world, const MaterialDispatch& materials, glm::vec4* accumulation, float* luminanceSquares, dataPixels* pixels)
+	{
+		uint32_t pixelIndex = i + j * cam.getImageSize().x;
+		glm::vec4 acc = accumulation[pixelIndex];
+		uint32_t samples = samplesToTake(acc, luminanceSquares[pixelIndex], samplesCount, settings);
+		if (samples > 0) {
+			float squares = luminanceSquares[pixelIndex];
+			acc += glm::vec4(cam.samplePixel(i, j, uint32_t(acc.w), samples, world, materials, &squares), float(samples));
+			accumulation[pixelIndex] = acc;
+			luminanceSquares[pixelIndex] = squares;
+		}
+		//Converged pixels too, the round that last sampled them may have run without pixels
+		if (pixels)
+			pixels[pixelIndex] = cam.convertColor(glm::vec3(acc) / acc.w);
+		return samples;
+	}
+}
@@ -0,0 +1,99 @@
+#include "pch.h"
+#include "CpuRenderer.h"
+
+#include <algorithm>
+
+CpuRenderer::CpuRenderer(const Scene& scene, const Camera& cam, uint32_t threadsCount, uint32_t tileSize)
+	: RenderBackend(cam), world(scene.getNodes().data(), scene.getNodesCount(), scene.getHostPrimitives(nullptr)),
+	materials(scene.getHostMaterialTable()), pool(threadsCount), tileSize(tileSize > 0 ? tileSize : 16)
+{
+	glm::u32vec2 imgSize = cam.getImageSize();
+	accumulation.resize(imgSize.x * imgSize.y);
+	luminanceSquares.resize(imgSize.x * imgSize.y);
+	workerSamples.resize(pool.getThreadsCount());
+	resetAccumulation();
+}
+
+void CpuRenderer::resetAccumulation()
+{
+	std::fill(accumulation.begin(), accumulation.end(), glm::vec4(0.0f));
+	std::fill(luminanceSquares.begin(), luminanceSquares.end(), 0.0f);
+	accumulatedSamples = 0;
+}
+
+void CpuRenderer::readRadiance(glm::vec3* radiance) const
+{
+	for (size_t i = 0; i < accumulation.size(); i++)
+		radiance[i] = accumulation[i].w > 0.0f ? glm::vec3(accumulation[i]) / accumulation[i].w : glm::vec3(0.0f);
+}
+
+void CpuRenderer::readAccumulation(glm::vec4* output) const
+{
+	std::copy(accumulation.begin(), accumulation.end(), output);
+}
+
+void CpuRenderer::accumulate(uint32_t samplesCount, dataPixels* pixels)
+{
+	if (samplesCount == 0)
+		return;
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	uint32_t tilesX = (imgSize.x + tileSize - 1) / tileSize;
+	uint32_t tilesY = (imgSize.y + tileSize - 1) / tileSize;
+	Hittable* worldPtr = &world;
+
+	pool.parallelFor(tilesX * tilesY, [&](uint32_t tileIdx, uint32_t) {
+		uint32_t x0 = (tileIdx % tilesX) * tileSize;
+		uint32_t y0 = (tileIdx / tilesX) * tileSize;
+		uint32_t x1 = std::min(x0 + tileSize, imgSize.x);
+		uint32_t y1 = std::min(y0 + tileSize, imgSize.y);
+
+		for (uint32_t j = y0; j < y1; j++) {
+			for (uint32_t i = x0; i < x1; i++) {
+				uint32_t pixelIndex = i + j * imgSize.x;
+				glm::vec4& acc = accumulation[pixelIndex];
+				acc += glm::vec4(cam.samplePixel(i, j, accumulatedSamples, samplesCount, &worldPtr, materials, &luminanceSquares[pixelIndex]),
+					float(samplesCount));
+				if (pixels)
+					pixels[pixelIndex] = cam.convertColor(glm::vec3(acc) / acc.w);
+			}
+		}
+	});
+
+	accumulatedSamples += samplesCount;
+}
+
+uint64_t CpuRenderer::accumulateAdaptive(uint32_t samplesCount, const Adaptive::Settings& settings, dataPixels* pixels)
+{
+	if (samplesCount == 0)
+		return 0;
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	uint32_t tilesX = (imgSize.x + tileSize - 1) / tileSize;
+	uint32_t tilesY = (imgSize.y + tileSize - 1) / tileSize;
+	Hittable* worldPtr = &world;
+	std::fill(workerSamples.begin(), workerSamples.end(), 0);
+
+	pool.parallelFor(tilesX * tilesY, [&](uint32_t tileIdx, uint32_t workerIdx) {
+		uint32_t x0 = (tileIdx % tilesX) * tileSize;
+		uint32_t y0 = (tileIdx / tilesX) * tileSize;
+		uint32_t x1 = std::min(x0 + tileSize, imgSize.x);
+		uint32_t y1 = std::min(y0 + tileSize, imgSize.y);
+
+		uint64_t taken = 0;
+		for (uint32_t j = y0; j < y1; j++) {
+			for (uint32_t i = x0; i < x1; i++)
+				taken += Adaptive::accumulatePixel(i, j, cam, samplesCount, settings, &worldPtr, materials, accumulation.data(),
+					luminanceSquares.data(), pixels);
+		}
+		workerSamples[workerIdx] += taken;
+	});
+
+	//No pixel got more than samplesCount, so a uniform accumulate after adaptive rounds never reuses a sample index
+	accumulatedSamples += samplesCount;
+
+	uint64_t total = 0;
+	for (uint64_t taken : workerSamples)
+		total += taken;
+	return total;
+}
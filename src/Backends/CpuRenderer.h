@@ -0,0 +1,33 @@
+#pragma once
+#include "RenderBackend.h"
+#include "../Raytracing/Scene.h"
+#include "../Raytracing/Acceleration/BVH.h"
+#include "../Utils/ThreadPool.h"
+#include <vector>
+
+//Host backend, runs the same Camera::samplePixel code as the render kernel
+//over image tiles spread across a work stealing thread pool
+class CpuRenderer : public RenderBackend
+{
+public:
+	//scene has to outlive the renderer, threadsCount 0 - one thread per core
+	CpuRenderer(const Scene& scene, const Camera& cam, uint32_t threadsCount = 0, uint32_t tileSize = 16);
+
+	void accumulate(uint32_t samplesCount, dataPixels* pixels) override;
+	uint64_t accumulateAdaptive(uint32_t samplesCount, const Adaptive::Settings& settings, dataPixels* pixels) override;
+	void resetAccumulation() override;
+	void readRadiance(glm::vec3* radiance) const override;
+	void readAccumulation(glm::vec4* output) const override;
+	const char* getName() const override { return "CPU"; }
+
+	inline uint32_t getThreadsCount() const { return pool.getThreadsCount(); }
+
+private:
+	BVH<ScenePrimitives> world;
+	MaterialTable materials;
+	ThreadPool pool;
+	uint32_t tileSize;
+	std::vector<glm::vec4> accumulation;
+	std::vector<float> luminanceSquares;
+	std::vector<uint64_t> workerSamples; //Samples taken by every worker in the last adaptive round
+};
@@ -0,0 +1,215 @@
+#include "pch.h"
+#include "CudaRenderer.h"
+
+#include "../Raytracing/Acceleration/BVH.h"
+#include "../Raytracing/Materials/MaterialTable.h"
+#include "../Utils/CudaErrors.h"
+
+#include <device_launch_parameters.h>
+#include <vector>
+
+template<typename MaterialDispatch>
+__global__ void accumulateSamples(glm::vec4* accumulation, float* luminanceSquares, dataPixels* data, Camera cam, Hittable** world,
+	MaterialDispatch materials, uint32_t firstSample, uint32_t samplesCount)
+{
+	uint32_t i = threadIdx.x + blockIdx.x * blockDim.x;
+	uint32_t j = threadIdx.y + blockIdx.y * blockDim.y;
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	if ((i >= imgSize.x) || (j >= imgSize.y))
+		return;
+
+	uint32_t pixelIndex = i + j * imgSize.x;
+	glm::vec4 acc = accumulation[pixelIndex];
+	float squares = luminanceSquares[pixelIndex];
+	acc += glm::vec4(cam.samplePixel(i, j, firstSample, samplesCount, world, materials, &squares), float(samplesCount));
+	accumulation[pixelIndex] = acc;
+	luminanceSquares[pixelIndex] = squares;
+	if (data)
+		data[pixelIndex] = cam.convertColor(glm::vec3(acc) / acc.w);
+}
+
+template<typename MaterialDispatch>
+__global__ void accumulateAdaptiveSamples(glm::vec4* accumulation, float* luminanceSquares, dataPixels* data, Camera cam, Hittable** world,
+	MaterialDispatch materials, uint32_t samplesCount, Adaptive::Settings settings, unsigned long long* samplesTaken)
+{
+	uint32_t i = threadIdx.x + blockIdx.x * blockDim.x;
+	uint32_t j = threadIdx.y + blockIdx.y * blockDim.y;
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	if ((i >= imgSize.x) || (j >= imgSize.y))
+		return;
+
+	uint32_t taken = Adaptive::accumulatePixel(i, j, cam, samplesCount, settings, world, materials, accumulation, luminanceSquares, data);
+	if (taken > 0)
+		atomicAdd(samplesTaken, (unsigned long long)taken);
+}
+
+__global__ void initMaterials(Material** materials, const MaterialData* materialsData, int materialsCount)
+{
+	int i = threadIdx.x + blockIdx.x * blockDim.x;
+	if (i >= materialsCount)
+		return;
+
+	const MaterialData& data = materialsData[i];
+	switch (data.type) {
+	case MaterialType::Lambertian:
+		materials[i] = new Materials::Lambertian(data.albedo);
+		break;
+	case MaterialType::Metal:
+		materials[i] = new Materials::Metal(data.albedo, data.param);
+		break;
+	case MaterialType::Dielectric:
+		materials[i] = new Materials::Dielectric(data.param);
+		break;
+	}
+}
+
+__global__ void initWorld(Hittable** world, const BVHNode* nodes, int nodesCount, ScenePrimitives primitives)
+{
+	if (threadIdx.x != 0 || blockIdx.x != 0)
+		return;
+
+	*world = new BVH<ScenePrimitives>(nodes, nodesCount, primitives);
+}
+
+__global__ void freeMaterials(Material** materials, int materialsCount)
+{
+	int i = threadIdx.x + blockIdx.x * blockDim.x;
+	if (i >= materialsCount)
+		return;
+
+	delete materials[i];
+}
+
+__global__ void freeWorld(Hittable** world) {
+	delete *world;
+}
+
+CudaRenderer::CudaRenderer(Scene& scene, const Camera& cam, bool useMaterialTable)
+	: RenderBackend(cam), scene(scene), useMaterialTable(useMaterialTable)
+{
+	scene.upload();
+
+	//Material table dispatches with a switch, virtual path only needs device Material objects for comparison
+	int materialsCount = scene.getMaterialsCount();
+	if (!useMaterialTable) {
+		checkCudaErrors(cudaMalloc((void**)&materials, materialsCount * sizeof(Material*)));
+		initMaterials<<<materialsCount / 64 + 1, 64>>>(materials, scene.getDeviceMaterials(), materialsCount);
+		checkCudaErrors(cudaGetLastError());
+	}
+
+	checkCudaErrors(cudaMalloc((void**)&world, sizeof(Hittable*)));
+	initWorld<<<1, 1>>>(world, scene.getDeviceNodes(), scene.getNodesCount(), scene.getDevicePrimitives(materials));
+	checkCudaErrors(cudaGetLastError());
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	checkCudaErrors(cudaMalloc((void**)&accumulation, imgSize.x * imgSize.y * sizeof(glm::vec4)));
+	checkCudaErrors(cudaMalloc((void**)&luminanceSquares, imgSize.x * imgSize.y * sizeof(float)));
+	checkCudaErrors(cudaMalloc((void**)&samplesTaken, sizeof(unsigned long long)));
+	checkCudaErrors(cudaMalloc((void**)&pixels, imgSize.x * imgSize.y * sizeof(dataPixels)));
+	resetAccumulation();
+	checkCudaErrors(cudaDeviceSynchronize());
+}
+
+CudaRenderer::~CudaRenderer()
+{
+	freeWorld<<<1, 1>>>(world);
+	if (materials)
+		freeMaterials<<<scene.getMaterialsCount() / 64 + 1, 64>>>(materials, scene.getMaterialsCount());
+	checkCudaErrors(cudaGetLastError());
+	checkCudaErrors(cudaDeviceSynchronize());
+	checkCudaErrors(cudaFree(world));
+	checkCudaErrors(cudaFree(materials));
+	checkCudaErrors(cudaFree(accumulation));
+	checkCudaErrors(cudaFree(luminanceSquares));
+	checkCudaErrors(cudaFree(samplesTaken));
+	checkCudaErrors(cudaFree(pixels));
+	scene.freeDevice();
+}
+
+bool CudaRenderer::isAvailable()
+{
+	int devicesCount = 0;
+	return cudaGetDeviceCount(&devicesCount) == cudaSuccess && devicesCount > 0;
+}
+
+void CudaRenderer::resetAccumulation()
+{
+	glm::u32vec2 imgSize = cam.getImageSize();
+	checkCudaErrors(cudaMemset(accumulation, 0, imgSize.x * imgSize.y * sizeof(glm::vec4)));
+	checkCudaErrors(cudaMemset(luminanceSquares, 0, imgSize.x * imgSize.y * sizeof(float)));
+	accumulatedSamples = 0;
+}
+
+void CudaRenderer::readRadiance(glm::vec3* radiance) const
+{
+	glm::u32vec2 imgSize = cam.getImageSize();
+	std::vector<glm::vec4> hostAccumulation(imgSize.x * imgSize.y);
+	checkCudaErrors(cudaMemcpy(hostAccumulation.data(), accumulation, hostAccumulation.size() * sizeof(glm::vec4), cudaMemcpyDeviceToHost));
+
+	for (size_t i = 0; i < hostAccumulation.size(); i++)
+		radiance[i] = hostAccumulation[i].w > 0.0f ? glm::vec3(hostAccumulation[i]) / hostAccumulation[i].w : glm::vec3(0.0f);
+}
+
+void CudaRenderer::readAccumulation(glm::vec4* output) const
+{
+	glm::u32vec2 imgSize = cam.getImageSize();
+	checkCudaErrors(cudaMemcpy(output, accumulation, size_t(imgSize.x) * imgSize.y * sizeof(glm::vec4), cudaMemcpyDeviceToHost));
+}
+
+void CudaRenderer::accumulate(uint32_t samplesCount, dataPixels* output)
+{
+	if (samplesCount == 0)
+		return;
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	int threadsX = 8, threadsY = 8;
+	dim3 blocks(imgSize.x / threadsX + 1, imgSize.y / threadsY + 1);
+	dim3 threads(threadsX, threadsY);
+	//Progressive frames only read the accumulation, the 8 bit image is written when it's asked for
+	dataPixels* data = output ? pixels : nullptr;
+	if (useMaterialTable)
+		accumulateSamples<<<blocks, threads>>>(accumulation, luminanceSquares, data, cam, world, scene.getDeviceMaterialTable(),
+			accumulatedSamples, samplesCount);
+	else
+		accumulateSamples<<<blocks, threads>>>(accumulation, luminanceSquares, data, cam, world, VirtualMaterials(), accumulatedSamples,
+			samplesCount);
+	checkCudaErrors(cudaGetLastError());
+
+	//The copy waits for the kernel, without one the caller still times finished samples
+	if (output)
+		checkCudaErrors(cudaMemcpy(output, pixels, imgSize.x * imgSize.y * sizeof(dataPixels), cudaMemcpyDeviceToHost));
+	else
+		checkCudaErrors(cudaDeviceSynchronize());
+	accumulatedSamples += samplesCount;
+}
+
+uint64_t CudaRenderer::accumulateAdaptive(uint32_t samplesCount, const Adaptive::Settings& settings, dataPixels* output)
+{
+	if (samplesCount == 0)
+		return 0;
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	int threadsX = 8, threadsY = 8;
+	dim3 blocks(imgSize.x / threadsX + 1, imgSize.y / threadsY + 1);
+	dim3 threads(threadsX, threadsY);
+	checkCudaErrors(cudaMemset(samplesTaken, 0, sizeof(unsigned long long)));
+	dataPixels* data = output ? pixels : nullptr;
+	if (useMaterialTable)
+		accumulateAdaptiveSamples<<<blocks, threads>>>(accumulation, luminanceSquares, data, cam, world, scene.getDeviceMaterialTable(),
+			samplesCount, settings, samplesTaken);
+	else
+		accumulateAdaptiveSamples<<<blocks, threads>>>(accumulation, luminanceSquares, data, cam, world, VirtualMaterials(), samplesCount,
+			settings, samplesTaken);
+	checkCudaErrors(cudaGetLastError());
+
+	unsigned long long taken = 0;
+	checkCudaErrors(cudaMemcpy(&taken, samplesTaken, sizeof(unsigned long long), cudaMemcpyDeviceToHost));
+	if (output)
+		checkCudaErrors(cudaMemcpy(output, pixels, imgSize.x * imgSize.y * sizeof(dataPixels), cudaMemcpyDeviceToHost));
+
+	//No pixel got more than samplesCount, so a uniform accumulate after adaptive rounds never reuses a sample index
+	accumulatedSamples += samplesCount;
+	return taken;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "RenderBackend.h"
+#include "../Raytracing/Scene.h"
+
+//Device backend. The constructor uploads the scene and builds the world on the GPU,
+//everything stays resident until the renderer is destroyed
+class CudaRenderer : public RenderBackend
+{
+public:
+	//scene has to outlive the renderer, useMaterialTable false - virtual Material::scatter path
+	CudaRenderer(Scene& scene, const Camera& cam, bool useMaterialTable = true);
+	~CudaRenderer();
+
+	CudaRenderer(const CudaRenderer&) = delete;
+	CudaRenderer& operator=(const CudaRenderer&) = delete;
+
+	void accumulate(uint32_t samplesCount, dataPixels* pixels) override;
+	uint64_t accumulateAdaptive(uint32_t samplesCount, const Adaptive::Settings& settings, dataPixels* pixels) override;
+	void resetAccumulation() override;
+	void readRadiance(glm::vec3* radiance) const override;
+	void readAccumulation(glm::vec4* output) const override;
+	const char* getName() const override { return "CUDA"; }
+
+	//Any CUDA capable device present
+	static bool isAvailable();
+
+private:
+	Scene& scene;
+	bool useMaterialTable;
+
+	Hittable** world = nullptr;
+	Material** materials = nullptr;
+	glm::vec4* accumulation = nullptr;
+	float* luminanceSquares = nullptr;
+	unsigned long long* samplesTaken = nullptr;
+	dataPixels* pixels = nullptr;
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include "../Camera.h"
+#include "Adaptive.h"
+#include <algorithm>
+
+//Common interface of CpuRenderer and CudaRenderer. Both keep a float accumulation buffer
+//(rgb - sum of samples, w - samples count) so the image can converge over many calls
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() = default;
+
+	//Adds samplesCount samples per pixel and writes the averaged image to pixels
+	//(getImageSize().x * getImageSize().y entries), pixels == nullptr - only the accumulation buffer grows.
+	//Returns once the samples are done on the device too, so the call can be timed
+	virtual void accumulate(uint32_t samplesCount, dataPixels* pixels) = 0;
+	virtual void resetAccumulation() = 0;
+	//Averaged linear color (before gamma) of every pixel
+	virtual void readRadiance(glm::vec3* radiance) const = 0;
+	//The accumulation buffer as it is, rgb - sum of samples, w - their count. What the window displays, dividing,
+	//tone mapping and gamma happen in the shader
+	virtual void readAccumulation(glm::vec4* accumulation) const = 0;
+	virtual const char* getName() const = 0;
+
+	//Adds up to samplesCount samples to every pixel settings still consider noisy and returns the samples
+	//taken. Backends without per pixel sample counts add samplesCount everywhere
+	virtual uint64_t accumulateAdaptive(uint32_t samplesCount, const Adaptive::Settings& settings, dataPixels* pixels) {
+		accumulate(samplesCount, pixels);
+		return uint64_t(samplesCount) * getImageSize().x * getImageSize().y;
+	}
+
+	//Whole image in one go with the camera samples per pixel
+	void render(dataPixels* pixels) {
+		resetAccumulation();
+		accumulate(cam.getPerPixelSamples(), pixels);
+	}
+
+	//Whole image with the same total budget as render, spent in rounds on the pixels that are still noisy.
+	//Returns the samples taken, less than the budget when every pixel converged early
+	uint64_t renderAdaptive(Adaptive::Settings settings, dataPixels* pixels) {
+		resetAccumulation();
+		if (settings.samplesPerPixel == 0)
+			settings.samplesPerPixel = cam.getPerPixelSamples();
+		if (settings.maxSamples == 0)
+			settings.maxSamples = settings.samplesPerPixel * 8;
+		settings.minSamples = std::max(std::min(settings.minSamples, settings.samplesPerPixel), 1u);
+		settings.batchSamples = std::max(settings.batchSamples, 1u);
+
+		glm::u32vec2 imgSize = getImageSize();
+		uint64_t budget = uint64_t(imgSize.x) * imgSize.y * settings.samplesPerPixel;
+		uint64_t taken = accumulateAdaptive(settings.minSamples, settings, pixels);
+		uint64_t noisyPixels = uint64_t(imgSize.x) * imgSize.y;
+		while (taken < budget && noisyPixels > 0) {
+			//Smaller batches near the end so the last round doesn't overshoot the budget
+			uint64_t batch = std::min<uint64_t>(settings.batchSamples, std::max<uint64_t>((budget - taken) / noisyPixels, 1));
+			uint64_t round = accumulateAdaptive(uint32_t(batch), settings, pixels);
+			taken += round;
+			noisyPixels = (round + batch - 1) / batch;
+		}
+		return taken;
+	}
+
+	inline const Camera& getCamera() const { return cam; }
+	inline glm::u32vec2 getImageSize() const { return cam.getImageSize(); }
+	inline uint32_t getAccumulatedSamples() const { return accumulatedSamples; }
+
+protected:
+	RenderBackend(const Camera& cam) : cam(cam) {}
+
+	Camera cam;
+	uint32_t accumulatedSamples = 0;
+};
@@ -0,0 +1,223 @@
+#pragma once
+#include "../Camera.h"
+#include "../Raytracing/Objects/ScenePrimitives.h"
+#include "../Raytracing/Acceleration/BVH.h"
+#include "../Raytracing/Materials/MaterialTable.h"
+
+//Wavefront path tracing. Instead of one thread following its path through every bounce, each stage runs
+//over a whole queue of paths: generate, then intersect -> shade -> compact once per bounce, so finished
+//paths drop out of the queue instead of idling next to long ones. The per path functions below are shared
+//by WavefrontCpuRenderer and WavefrontCudaRenderer
+namespace Wavefront
+{
+	constexpr size_t bufferAlignment = 256;
+
+	//Optional pass between intersect and shade that groups paths so neighbours run the same scatter code
+	enum class SortMode : uint32_t {
+		None = 0,
+		Material, //Miss, Lambertian, Metal, Dielectric
+		MaterialOctant //Material, then direction octant
+	};
+
+	constexpr uint32_t materialKeysCount = 4; //Miss + every MaterialType
+	constexpr uint32_t sortKeysCount = materialKeysCount * 8;
+	constexpr uint32_t warpSize = 32; //Group size for the coherence counters
+
+	//Counters of the last accumulate calls, stage times are only measured by the host pipeline
+	struct Stats {
+		double generate = 0.0;
+		double intersect = 0.0;
+		double sort = 0.0;
+		double shade = 0.0;
+		double compact = 0.0;
+		uint64_t pathsShaded = 0;
+
+		//Sum over warp sized groups of distinct materials in the group, before and after sorting
+		uint64_t sortedGroups = 0;
+		uint64_t materialsBeforeSort = 0;
+		uint64_t materialsAfterSort = 0;
+	};
+
+	//Structure of arrays over capacity paths, all arrays point into one buffer
+	struct PathQueue {
+		glm::vec3* origins = nullptr;
+		glm::vec3* directions = nullptr;
+		glm::vec3* throughputs = nullptr;
+		uint32_t* pixels = nullptr;
+		float* hitDistances = nullptr; //infinity - the ray escaped
+		uint32_t* hitPrims = nullptr;
+		uint32_t* hitParts = nullptr; //Triangle of a hit instance
+		uint32_t* alive = nullptr; //Written by shade, 0 - the path is finished
+		uint32_t* keys = nullptr; //Written by sortKey
+
+		//Bytes needed for capacity paths
+		static size_t bufferSize(uint32_t capacity) {
+			size_t size = 0;
+			carve(nullptr, capacity, size);
+			return size;
+		}
+
+		//Points the arrays into buffer of bufferSize(capacity) bytes, host or device memory
+		static PathQueue carve(unsigned char* buffer, uint32_t capacity) {
+			size_t size = 0;
+			return carve(buffer, capacity, size);
+		}
+
+	private:
+		template<typename T>
+		static T* section(unsigned char* buffer, size_t& offset, uint32_t capacity) {
+			offset = (offset + bufferAlignment - 1) / bufferAlignment * bufferAlignment;
+			T* ptr = buffer ? reinterpret_cast<T*>(buffer + offset) : nullptr;
+			offset += capacity * sizeof(T);
+			return ptr;
+		}
+
+		static PathQueue carve(unsigned char* buffer, uint32_t capacity, size_t& size) {
+			PathQueue queue;
+			queue.origins = section<glm::vec3>(buffer, size, capacity);
+			queue.directions = section<glm::vec3>(buffer, size, capacity);
+			queue.throughputs = section<glm::vec3>(buffer, size, capacity);
+			queue.pixels = section<uint32_t>(buffer, size, capacity);
+			queue.hitDistances = section<float>(buffer, size, capacity);
+			queue.hitPrims = section<uint32_t>(buffer, size, capacity);
+			queue.hitParts = section<uint32_t>(buffer, size, capacity);
+			queue.alive = section<uint32_t>(buffer, size, capacity);
+			queue.keys = section<uint32_t>(buffer, size, capacity);
+			return queue;
+		}
+	};
+
+	//Camera ray of pixel firstPixel + idx. A wave holds one path per pixel, so no two paths share an accumulation entry
+	__host__ __device__ inline void generate(const PathQueue& queue, uint32_t idx, const Camera& cam, uint32_t firstPixel, uint32_t sample)
+	{
+		uint32_t pixel = firstPixel + idx;
+		uint32_t width = cam.getImageSize().x;
+
+		Utils::RandState localRandState = Utils::makeRandState(pixel, sample, 0, cam.getSampler());
+		Ray r = cam.getRay(pixel % width, pixel / width, &localRandState);
+
+		queue.origins[idx] = r.origin();
+		queue.directions[idx] = r.direction();
+		queue.throughputs[idx] = glm::vec3(1.0f, 1.0f, 1.0f);
+		queue.pixels[idx] = pixel;
+	}
+
+	//Closest hit distance and primitive only, shade builds the hit record
+	template<typename Primitives>
+	__host__ __device__ inline void intersect(const PathQueue& queue, uint32_t idx, const BVH<Primitives>& world)
+	{
+		Ray r(queue.origins[idx], queue.directions[idx]);
+		float t;
+		uint32_t prim = 0, part = 0;
+		if (!world.findClosest(r, Interval(0.001f, Utils::infinity), t, prim, part))
+			t = Utils::infinity;
+
+		queue.hitDistances[idx] = t;
+		queue.hitPrims[idx] = prim;
+		queue.hitParts[idx] = part;
+	}
+
+	//Stores and returns the sort key of a path after intersect, in [0, sortKeysCount)
+	template<typename Primitives>
+	__host__ __device__ inline uint32_t sortKey(const PathQueue& queue, uint32_t idx, const BVH<Primitives>& world, const MaterialTable& materials, SortMode mode)
+	{
+		uint32_t key = 0;
+		if (queue.hitDistances[idx] != Utils::infinity) {
+			uint32_t materialId = world.getPrimitives().getMaterialId(queue.hitPrims[idx]);
+			key = 1 + static_cast<uint32_t>(materials.materials[materialId].type);
+		}
+
+		if (mode == SortMode::MaterialOctant) {
+			glm::vec3 d = queue.directions[idx];
+			key = key * 8 + (d.x < 0.0f ? 1 : 0) + (d.y < 0.0f ? 2 : 0) + (d.z < 0.0f ? 4 : 0);
+		}
+
+		queue.keys[idx] = key;
+		return key;
+	}
+
+	//Distinct materials among keys of paths [first, first + count), 1 means the whole group shades alike
+	__host__ __device__ inline uint32_t distinctMaterials(const PathQueue& queue, uint32_t first, uint32_t count, SortMode mode)
+	{
+		uint32_t mask = 0;
+		for (uint32_t idx = first; idx < first + count; idx++)
+			mask |= 1u << (mode == SortMode::MaterialOctant ? queue.keys[idx] / 8 : queue.keys[idx]);
+
+		uint32_t distinct = 0;
+		for (uint32_t k = 0; k < materialKeysCount; k++)
+			distinct += (mask >> k) & 1u;
+		return distinct;
+	}
+
+	//Moves a path together with its hit into slot, used by the sort pass
+	__host__ __device__ inline void reorder(const PathQueue& from, uint32_t idx, const PathQueue& to, uint32_t slot)
+	{
+		to.origins[slot] = from.origins[idx];
+		to.directions[slot] = from.directions[idx];
+		to.throughputs[slot] = from.throughputs[idx];
+		to.pixels[slot] = from.pixels[idx];
+		to.hitDistances[slot] = from.hitDistances[idx];
+		to.hitPrims[slot] = from.hitPrims[idx];
+		to.hitParts[slot] = from.hitParts[idx];
+		to.keys[slot] = from.keys[idx];
+	}
+
+	//Escaped paths add their radiance to accumulation (rgb only), scattered ones keep the new ray in their slot
+	template<typename Primitives, typename MaterialDispatch>
+	__host__ __device__ inline void shade(const PathQueue& queue, uint32_t idx, const Camera& cam, const BVH<Primitives>& world, const MaterialDispatch& materials,
+		uint32_t sample, uint32_t bounce, glm::vec4* accumulation)
+	{
+		Ray r(queue.origins[idx], queue.directions[idx]);
+		uint32_t pixel = queue.pixels[idx];
+		float t = queue.hitDistances[idx];
+
+		if (t == Utils::infinity) {
+			accumulation[pixel] += glm::vec4(queue.throughputs[idx] * Camera::background(r.direction()), 0.0f);
+			queue.alive[idx] = 0;
+			return;
+		}
+
+		hitData rec;
+		world.getPrimitives().hitRecord(queue.hitPrims[idx], queue.hitParts[idx], r, Interval(0.001f, Utils::infinity), t, rec);
+
+		//Same random stream as Camera::rayColor at this bounce, both integrators give the same image
+		Utils::RandState localRandState = Utils::makeRandState(pixel, sample, 0, cam.getSampler());
+		Utils::setBounce(bounce + 1, &localRandState);
+
+		Ray scattered(glm::vec3(0.0f), glm::vec3(0.0f));
+		glm::vec3 attenuation;
+		if (!materials.scatter(r, rec, attenuation, scattered, &localRandState)) {
+			queue.alive[idx] = 0;
+			return;
+		}
+
+		glm::vec3 throughput = queue.throughputs[idx] * attenuation;
+		if (!cam.russianRoulette(bounce, throughput, &localRandState)) {
+			queue.alive[idx] = 0;
+			return;
+		}
+
+		queue.origins[idx] = scattered.origin();
+		queue.directions[idx] = scattered.direction();
+		queue.throughputs[idx] = throughput;
+		queue.alive[idx] = 1;
+	}
+
+	//Moves a live path into slot of the next bounce queue
+	__host__ __device__ inline void compact(const PathQueue& from, uint32_t idx, const PathQueue& to, uint32_t slot)
+	{
+		to.origins[slot] = from.origins[idx];
+		to.directions[slot] = from.directions[idx];
+		to.throughputs[slot] = from.throughputs[idx];
+		to.pixels[slot] = from.pixels[idx];
+	}
+
+	//After all waves of a call, samplesCount more samples are in the rgb sum of the pixel
+	__host__ __device__ inline void resolve(uint32_t pixel, const Camera& cam, uint32_t samplesCount, glm::vec4* accumulation, dataPixels* pixels)
+	{
+		glm::vec4& acc = accumulation[pixel];
+		acc.w += float(samplesCount);
+		if (pixels)
+			pixels[pixel] = cam.convertColor(glm::vec3(acc) / acc.w);
+	}
+}
@@ -0,0 +1,173 @@
+#include "pch.h"
+#include "WavefrontCpuRenderer.h"
+#include "../Utils/Timer.h"
+
+#include <algorithm>
+
+WavefrontCpuRenderer::WavefrontCpuRenderer(const Scene& scene, const Camera& cam, uint32_t threadsCount, Wavefront::SortMode sortMode,
+	uint32_t _waveSize)
+	: RenderBackend(cam), world(scene.getNodes().data(), scene.getNodesCount(), scene.getHostPrimitives(nullptr)),
+	materials(scene.getHostMaterialTable()), pool(threadsCount), sortMode(sortMode)
+{
+	glm::u32vec2 imgSize = cam.getImageSize();
+	uint32_t pixelsCount = imgSize.x * imgSize.y;
+	waveSize = std::min(std::max(_waveSize, 1u), pixelsCount);
+
+	for (int q = 0; q < 2; q++) {
+		queueBuffers[q].resize(Wavefront::PathQueue::bufferSize(waveSize));
+		queues[q] = Wavefront::PathQueue::carve(queueBuffers[q].data(), waveSize);
+	}
+	chunkOffsets.resize(ThreadPool::chunksCount(waveSize));
+	chunkHistograms.resize(chunkOffsets.size() * Wavefront::sortKeysCount);
+
+	accumulation.resize(pixelsCount);
+	resetAccumulation();
+}
+
+void WavefrontCpuRenderer::resetAccumulation()
+{
+	std::fill(accumulation.begin(), accumulation.end(), glm::vec4(0.0f));
+	accumulatedSamples = 0;
+	stats = Wavefront::Stats();
+}
+
+void WavefrontCpuRenderer::readRadiance(glm::vec3* radiance) const
+{
+	for (size_t i = 0; i < accumulation.size(); i++)
+		radiance[i] = accumulation[i].w > 0.0f ? glm::vec3(accumulation[i]) / accumulation[i].w : glm::vec3(0.0f);
+}
+
+void WavefrontCpuRenderer::readAccumulation(glm::vec4* output) const
+{
+	std::copy(accumulation.begin(), accumulation.end(), output);
+}
+
+uint32_t WavefrontCpuRenderer::compactQueue(const Wavefront::PathQueue& from, uint32_t count, const Wavefront::PathQueue& to)
+{
+	//Count per chunk, prefix sum, then every chunk copies to its own range. Keeps the path order stable
+	uint32_t chunks = ThreadPool::chunksCount(count);
+	pool.parallelForChunks(count, [&](uint32_t chunk, uint32_t first, uint32_t last) {
+		uint32_t alive = 0;
+		for (uint32_t idx = first; idx < last; idx++)
+			alive += from.alive[idx];
+		chunkOffsets[chunk] = alive;
+	});
+
+	uint32_t total = 0;
+	for (uint32_t chunk = 0; chunk < chunks; chunk++) {
+		uint32_t alive = chunkOffsets[chunk];
+		chunkOffsets[chunk] = total;
+		total += alive;
+	}
+
+	pool.parallelForChunks(count, [&](uint32_t chunk, uint32_t first, uint32_t last) {
+		uint32_t slot = chunkOffsets[chunk];
+		for (uint32_t idx = first; idx < last; idx++) {
+			if (from.alive[idx])
+				Wavefront::compact(from, idx, to, slot++);
+		}
+	});
+
+	return total;
+}
+
+void WavefrontCpuRenderer::sortQueue(const Wavefront::PathQueue& from, uint32_t count, const Wavefront::PathQueue& to)
+{
+	uint32_t chunks = ThreadPool::chunksCount(count);
+	pool.parallelForChunks(count, [&](uint32_t chunk, uint32_t first, uint32_t last) {
+		uint32_t* histogram = &chunkHistograms[chunk * Wavefront::sortKeysCount];
+		std::fill(histogram, histogram + Wavefront::sortKeysCount, 0u);
+		for (uint32_t idx = first; idx < last; idx++)
+			histogram[Wavefront::sortKey(from, idx, world, materials, sortMode)]++;
+	});
+
+	//Key major, chunk minor, so every chunk writes its part of each key range in order
+	uint32_t total = 0;
+	for (uint32_t key = 0; key < Wavefront::sortKeysCount; key++) {
+		for (uint32_t chunk = 0; chunk < chunks; chunk++) {
+			uint32_t& entry = chunkHistograms[chunk * Wavefront::sortKeysCount + key];
+			uint32_t keyCount = entry;
+			entry = total;
+			total += keyCount;
+		}
+	}
+
+	pool.parallelForChunks(count, [&](uint32_t chunk, uint32_t first, uint32_t last) {
+		uint32_t* offsets = &chunkHistograms[chunk * Wavefront::sortKeysCount];
+		for (uint32_t idx = first; idx < last; idx++)
+			Wavefront::reorder(from, idx, to, offsets[from.keys[idx]]++);
+	});
+}
+
+uint64_t WavefrontCpuRenderer::countDistinctMaterials(const Wavefront::PathQueue& queue, uint32_t count)
+{
+	//ThreadPool::chunkSize is a multiple of warpSize, so groups never straddle chunks
+	uint32_t chunks = ThreadPool::chunksCount(count);
+	pool.parallelForChunks(count, [&](uint32_t chunk, uint32_t first, uint32_t last) {
+		uint32_t distinct = 0;
+		for (uint32_t group = first; group < last; group += Wavefront::warpSize)
+			distinct += Wavefront::distinctMaterials(queue, group, std::min(Wavefront::warpSize, last - group), sortMode);
+		chunkOffsets[chunk] = distinct;
+	});
+
+	uint64_t total = 0;
+	for (uint32_t chunk = 0; chunk < chunks; chunk++)
+		total += chunkOffsets[chunk];
+	return total;
+}
+
+void WavefrontCpuRenderer::traceWave(uint32_t firstPixel, uint32_t pathsCount, uint32_t sample)
+{
+	auto start = std::chrono::steady_clock::now();
+	pool.parallelForEach(pathsCount, [&](uint32_t idx) { Wavefront::generate(queues[0], idx, cam, firstPixel, sample); });
+	stats.generate += Utils::secondsSince(start);
+
+	int current = 0;
+	for (int bounce = 0; bounce < cam.getMaxRecursionDepth() && pathsCount > 0; bounce++) {
+		start = std::chrono::steady_clock::now();
+		pool.parallelForEach(pathsCount, [&](uint32_t idx) { Wavefront::intersect(queues[current], idx, world); });
+		stats.intersect += Utils::secondsSince(start);
+
+		//Sorted paths are shaded in the other queue and compacted back
+		if (sortMode != Wavefront::SortMode::None) {
+			start = std::chrono::steady_clock::now();
+			sortQueue(queues[current], pathsCount, queues[1 - current]);
+			current = 1 - current;
+			stats.sort += Utils::secondsSince(start);
+
+			stats.sortedGroups += (pathsCount + Wavefront::warpSize - 1) / Wavefront::warpSize;
+			stats.materialsBeforeSort += countDistinctMaterials(queues[1 - current], pathsCount);
+			stats.materialsAfterSort += countDistinctMaterials(queues[current], pathsCount);
+		}
+
+		const Wavefront::PathQueue& queue = queues[current];
+		start = std::chrono::steady_clock::now();
+		pool.parallelForEach(pathsCount, [&](uint32_t idx) {
+			Wavefront::shade(queue, idx, cam, world, materials, sample, bounce, accumulation.data());
+		});
+		stats.shade += Utils::secondsSince(start);
+		stats.pathsShaded += pathsCount;
+
+		start = std::chrono::steady_clock::now();
+		pathsCount = compactQueue(queue, pathsCount, queues[1 - current]);
+		stats.compact += Utils::secondsSince(start);
+		current = 1 - current;
+	}
+}
+
+void WavefrontCpuRenderer::accumulate(uint32_t samplesCount, dataPixels* pixels)
+{
+	if (samplesCount == 0)
+		return;
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	uint32_t pixelsCount = imgSize.x * imgSize.y;
+
+	for (uint32_t sample = accumulatedSamples; sample < accumulatedSamples + samplesCount; sample++) {
+		for (uint32_t firstPixel = 0; firstPixel < pixelsCount; firstPixel += waveSize)
+			traceWave(firstPixel, std::min(waveSize, pixelsCount - firstPixel), sample);
+	}
+
+	pool.parallelForEach(pixelsCount, [&](uint32_t pixel) { Wavefront::resolve(pixel, cam, samplesCount, accumulation.data(), pixels); });
+	accumulatedSamples += samplesCount;
+}
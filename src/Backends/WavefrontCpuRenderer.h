@@ -0,0 +1,47 @@
+#pragma once
+#include "RenderBackend.h"
+#include "Wavefront.h"
+#include "../Raytracing/Scene.h"
+#include "../Utils/ThreadPool.h"
+#include <vector>
+
+//Host version of the wavefront pipeline (see Wavefront.h). Runs the same stage functions as
+//WavefrontCudaRenderer, one parallel pass over the queue per stage, so the pipeline can be checked
+//against CpuRenderer and profiled without a GPU
+class WavefrontCpuRenderer : public RenderBackend
+{
+public:
+	//scene has to outlive the renderer, threadsCount 0 - one thread per core, waveSize - paths per queue
+	WavefrontCpuRenderer(const Scene& scene, const Camera& cam, uint32_t threadsCount = 0, Wavefront::SortMode sortMode = Wavefront::SortMode::None,
+		uint32_t waveSize = 1 << 20);
+
+	void accumulate(uint32_t samplesCount, dataPixels* pixels) override;
+	void resetAccumulation() override;
+	void readRadiance(glm::vec3* radiance) const override;
+	void readAccumulation(glm::vec4* output) const override;
+	const char* getName() const override { return "CPU wavefront"; }
+
+	//Since the last resetAccumulation
+	inline const Wavefront::Stats& getStats() const { return stats; }
+
+private:
+	//Live paths of from (shade has run) go to to, returns how many there are
+	uint32_t compactQueue(const Wavefront::PathQueue& from, uint32_t count, const Wavefront::PathQueue& to);
+	//Stable counting sort of from into to by Wavefront::sortKey
+	void sortQueue(const Wavefront::PathQueue& from, uint32_t count, const Wavefront::PathQueue& to);
+	uint64_t countDistinctMaterials(const Wavefront::PathQueue& queue, uint32_t count);
+	void traceWave(uint32_t firstPixel, uint32_t pathsCount, uint32_t sample);
+
+	BVH<ScenePrimitives> world;
+	MaterialTable materials;
+	ThreadPool pool;
+	Wavefront::SortMode sortMode;
+	uint32_t waveSize;
+
+	std::vector<unsigned char> queueBuffers[2];
+	Wavefront::PathQueue queues[2];
+	std::vector<uint32_t> chunkOffsets;
+	std::vector<uint32_t> chunkHistograms; //sortKeysCount entries per chunk
+	std::vector<glm::vec4> accumulation;
+	Wavefront::Stats stats;
+};
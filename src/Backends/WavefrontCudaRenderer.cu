@@ -0,0 +1,259 @@
+#include "pch.h"
+#include "WavefrontCudaRenderer.h"
+
+#include "../Utils/CudaErrors.h"
+
+#include <algorithm>
+#include <device_launch_parameters.h>
+#include <vector>
+
+namespace {
+	constexpr int threadsPerBlock = 128;
+
+	inline int blocksFor(uint32_t count) {
+		return (count + threadsPerBlock - 1) / threadsPerBlock;
+	}
+}
+
+//BVH has virtual functions, so it can't be a kernel parameter. Every kernel builds its own view from the plain parts
+__global__ void generateKernel(Wavefront::PathQueue queue, uint32_t pathsCount, Camera cam, uint32_t firstPixel, uint32_t sample)
+{
+	uint32_t idx = threadIdx.x + blockIdx.x * blockDim.x;
+	if (idx >= pathsCount)
+		return;
+
+	Wavefront::generate(queue, idx, cam, firstPixel, sample);
+}
+
+__global__ void intersectKernel(Wavefront::PathQueue queue, uint32_t pathsCount, const BVHNode* nodes, int nodesCount, ScenePrimitives primitives)
+{
+	uint32_t idx = threadIdx.x + blockIdx.x * blockDim.x;
+	if (idx >= pathsCount)
+		return;
+
+	BVH<ScenePrimitives> world(nodes, nodesCount, primitives);
+	Wavefront::intersect(queue, idx, world);
+}
+
+__global__ void shadeKernel(Wavefront::PathQueue queue, uint32_t pathsCount, Camera cam, const BVHNode* nodes, int nodesCount, ScenePrimitives primitives,
+	MaterialTable materials, uint32_t sample, uint32_t bounce, glm::vec4* accumulation)
+{
+	uint32_t idx = threadIdx.x + blockIdx.x * blockDim.x;
+	if (idx >= pathsCount)
+		return;
+
+	BVH<ScenePrimitives> world(nodes, nodesCount, primitives);
+	Wavefront::shade(queue, idx, cam, world, materials, sample, bounce, accumulation);
+}
+
+//keyOffsets holds per key counts here, keyOffsetsKernel turns them into offsets before scatterKernel
+__global__ void sortKeyKernel(Wavefront::PathQueue queue, uint32_t pathsCount, const BVHNode* nodes, int nodesCount, ScenePrimitives primitives,
+	MaterialTable materials, Wavefront::SortMode sortMode, uint32_t* keyOffsets)
+{
+	uint32_t idx = threadIdx.x + blockIdx.x * blockDim.x;
+	if (idx >= pathsCount)
+		return;
+
+	BVH<ScenePrimitives> world(nodes, nodesCount, primitives);
+	atomicAdd(&keyOffsets[Wavefront::sortKey(queue, idx, world, materials, sortMode)], 1u);
+}
+
+//Only sortKeysCount entries, one thread scans them so the host never waits for the counts
+__global__ void keyOffsetsKernel(uint32_t* keyOffsets)
+{
+	uint32_t total = 0;
+	for (uint32_t key = 0; key < Wavefront::sortKeysCount; key++) {
+		uint32_t keyCount = keyOffsets[key];
+		keyOffsets[key] = total;
+		total += keyCount;
+	}
+}
+
+//Order inside one key depends on scheduling, that's enough for coherent warps
+__global__ void scatterKernel(Wavefront::PathQueue from, uint32_t pathsCount, Wavefront::PathQueue to, uint32_t* keyOffsets)
+{
+	uint32_t idx = threadIdx.x + blockIdx.x * blockDim.x;
+	if (idx >= pathsCount)
+		return;
+
+	Wavefront::reorder(from, idx, to, atomicAdd(&keyOffsets[from.keys[idx]], 1u));
+}
+
+//One thread per warp sized group of paths
+__global__ void distinctMaterialsKernel(Wavefront::PathQueue queue, uint32_t pathsCount, Wavefront::SortMode sortMode, unsigned long long* distinctCount)
+{
+	uint32_t first = (threadIdx.x + blockIdx.x * blockDim.x) * Wavefront::warpSize;
+	if (first >= pathsCount)
+		return;
+
+	uint32_t count = min(Wavefront::warpSize, pathsCount - first);
+	atomicAdd(distinctCount, (unsigned long long)Wavefront::distinctMaterials(queue, first, count, sortMode));
+}
+
+//Slot order depends on scheduling, results don't since every path carries its pixel
+__global__ void compactKernel(Wavefront::PathQueue from, uint32_t pathsCount, Wavefront::PathQueue to, uint32_t* liveCount)
+{
+	uint32_t idx = threadIdx.x + blockIdx.x * blockDim.x;
+	if (idx >= pathsCount || !from.alive[idx])
+		return;
+
+	Wavefront::compact(from, idx, to, atomicAdd(liveCount, 1u));
+}
+
+__global__ void resolveKernel(uint32_t pixelsCount, Camera cam, uint32_t samplesCount, glm::vec4* accumulation, dataPixels* pixels)
+{
+	uint32_t pixel = threadIdx.x + blockIdx.x * blockDim.x;
+	if (pixel >= pixelsCount)
+		return;
+
+	Wavefront::resolve(pixel, cam, samplesCount, accumulation, pixels);
+}
+
+WavefrontCudaRenderer::WavefrontCudaRenderer(Scene& scene, const Camera& cam, Wavefront::SortMode sortMode, uint32_t _waveSize)
+	: RenderBackend(cam), scene(scene), sortMode(sortMode)
+{
+	scene.upload();
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	uint32_t pixelsCount = imgSize.x * imgSize.y;
+	waveSize = std::min(std::max(_waveSize, 1u), pixelsCount);
+
+	size_t queueSize = Wavefront::PathQueue::bufferSize(waveSize);
+	for (int q = 0; q < 2; q++) {
+		checkCudaErrors(cudaMalloc((void**)&queueBuffers[q], queueSize));
+		queues[q] = Wavefront::PathQueue::carve(queueBuffers[q], waveSize);
+	}
+	checkCudaErrors(cudaMalloc((void**)&liveCount, sizeof(uint32_t)));
+	checkCudaErrors(cudaMalloc((void**)&keyOffsets, Wavefront::sortKeysCount * sizeof(uint32_t)));
+	checkCudaErrors(cudaMalloc((void**)&distinctCounts, 2 * sizeof(unsigned long long)));
+
+	checkCudaErrors(cudaMalloc((void**)&accumulation, pixelsCount * sizeof(glm::vec4)));
+	checkCudaErrors(cudaMalloc((void**)&pixels, pixelsCount * sizeof(dataPixels)));
+	resetAccumulation();
+	checkCudaErrors(cudaDeviceSynchronize());
+}
+
+WavefrontCudaRenderer::~WavefrontCudaRenderer()
+{
+	checkCudaErrors(cudaDeviceSynchronize());
+	for (int q = 0; q < 2; q++)
+		checkCudaErrors(cudaFree(queueBuffers[q]));
+	checkCudaErrors(cudaFree(liveCount));
+	checkCudaErrors(cudaFree(keyOffsets));
+	checkCudaErrors(cudaFree(distinctCounts));
+	checkCudaErrors(cudaFree(accumulation));
+	checkCudaErrors(cudaFree(pixels));
+	scene.freeDevice();
+}
+
+void WavefrontCudaRenderer::resetAccumulation()
+{
+	glm::u32vec2 imgSize = cam.getImageSize();
+	checkCudaErrors(cudaMemset(accumulation, 0, imgSize.x * imgSize.y * sizeof(glm::vec4)));
+	checkCudaErrors(cudaMemset(distinctCounts, 0, 2 * sizeof(unsigned long long)));
+	accumulatedSamples = 0;
+	stats = Wavefront::Stats();
+}
+
+void WavefrontCudaRenderer::readRadiance(glm::vec3* radiance) const
+{
+	glm::u32vec2 imgSize = cam.getImageSize();
+	std::vector<glm::vec4> hostAccumulation(imgSize.x * imgSize.y);
+	checkCudaErrors(cudaMemcpy(hostAccumulation.data(), accumulation, hostAccumulation.size() * sizeof(glm::vec4), cudaMemcpyDeviceToHost));
+
+	for (size_t i = 0; i < hostAccumulation.size(); i++)
+		radiance[i] = hostAccumulation[i].w > 0.0f ? glm::vec3(hostAccumulation[i]) / hostAccumulation[i].w : glm::vec3(0.0f);
+}
+
+void WavefrontCudaRenderer::readAccumulation(glm::vec4* output) const
+{
+	glm::u32vec2 imgSize = cam.getImageSize();
+	checkCudaErrors(cudaMemcpy(output, accumulation, size_t(imgSize.x) * imgSize.y * sizeof(glm::vec4), cudaMemcpyDeviceToHost));
+}
+
+void WavefrontCudaRenderer::sortQueue(const Wavefront::PathQueue& from, uint32_t count, const Wavefront::PathQueue& to)
+{
+	checkCudaErrors(cudaMemset(keyOffsets, 0, Wavefront::sortKeysCount * sizeof(uint32_t)));
+	sortKeyKernel<<<blocksFor(count), threadsPerBlock>>>(from, count, scene.getDeviceNodes(), scene.getNodesCount(),
+		scene.getDevicePrimitives(nullptr), scene.getDeviceMaterialTable(), sortMode, keyOffsets);
+	keyOffsetsKernel<<<1, 1>>>(keyOffsets);
+	scatterKernel<<<blocksFor(count), threadsPerBlock>>>(from, count, to, keyOffsets);
+	checkCudaErrors(cudaGetLastError());
+}
+
+void WavefrontCudaRenderer::countDistinctMaterials(const Wavefront::PathQueue& queue, uint32_t count, unsigned long long* distinctCount)
+{
+	uint32_t groups = (count + Wavefront::warpSize - 1) / Wavefront::warpSize;
+	distinctMaterialsKernel<<<blocksFor(groups), threadsPerBlock>>>(queue, count, sortMode, distinctCount);
+	checkCudaErrors(cudaGetLastError());
+}
+
+void WavefrontCudaRenderer::traceWave(uint32_t firstPixel, uint32_t pathsCount, uint32_t sample)
+{
+	const BVHNode* nodes = scene.getDeviceNodes();
+	int nodesCount = scene.getNodesCount();
+	ScenePrimitives primitives = scene.getDevicePrimitives(nullptr);
+	MaterialTable materials = scene.getDeviceMaterialTable();
+
+	generateKernel<<<blocksFor(pathsCount), threadsPerBlock>>>(queues[0], pathsCount, cam, firstPixel, sample);
+	checkCudaErrors(cudaGetLastError());
+
+	int current = 0;
+	for (int bounce = 0; bounce < cam.getMaxRecursionDepth() && pathsCount > 0; bounce++) {
+		intersectKernel<<<blocksFor(pathsCount), threadsPerBlock>>>(queues[current], pathsCount, nodes, nodesCount, primitives);
+
+		//Sorted paths are shaded in the other queue and compacted back
+		if (sortMode != Wavefront::SortMode::None) {
+			sortQueue(queues[current], pathsCount, queues[1 - current]);
+			current = 1 - current;
+
+			stats.sortedGroups += (pathsCount + Wavefront::warpSize - 1) / Wavefront::warpSize;
+			countDistinctMaterials(queues[1 - current], pathsCount, &distinctCounts[0]);
+			countDistinctMaterials(queues[current], pathsCount, &distinctCounts[1]);
+		}
+
+		const Wavefront::PathQueue& queue = queues[current];
+		shadeKernel<<<blocksFor(pathsCount), threadsPerBlock>>>(queue, pathsCount, cam, nodes, nodesCount, primitives, materials, sample, bounce, accumulation);
+
+		checkCudaErrors(cudaMemset(liveCount, 0, sizeof(uint32_t)));
+		compactKernel<<<blocksFor(pathsCount), threadsPerBlock>>>(queue, pathsCount, queues[1 - current], liveCount);
+		checkCudaErrors(cudaGetLastError());
+
+		stats.pathsShaded += pathsCount;
+		checkCudaErrors(cudaMemcpy(&pathsCount, liveCount, sizeof(uint32_t), cudaMemcpyDeviceToHost));
+		current = 1 - current;
+	}
+}
+
+void WavefrontCudaRenderer::accumulate(uint32_t samplesCount, dataPixels* output)
+{
+	if (samplesCount == 0)
+		return;
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	uint32_t pixelsCount = imgSize.x * imgSize.y;
+
+	for (uint32_t sample = accumulatedSamples; sample < accumulatedSamples + samplesCount; sample++) {
+		for (uint32_t firstPixel = 0; firstPixel < pixelsCount; firstPixel += waveSize)
+			traceWave(firstPixel, std::min(waveSize, pixelsCount - firstPixel), sample);
+	}
+
+	//Without output only the sample counts are resolved, progressive frames read the accumulation instead
+	resolveKernel<<<blocksFor(pixelsCount), threadsPerBlock>>>(pixelsCount, cam, samplesCount, accumulation, output ? pixels : nullptr);
+	checkCudaErrors(cudaGetLastError());
+
+	//The copy waits for the kernels, without one the caller still times finished samples
+	if (output)
+		checkCudaErrors(cudaMemcpy(output, pixels, pixelsCount * sizeof(dataPixels), cudaMemcpyDeviceToHost));
+	else
+		checkCudaErrors(cudaDeviceSynchronize());
+
+	//Summed on the device since resetAccumulation, read once here instead of after every bounce
+	if (sortMode != Wavefront::SortMode::None) {
+		unsigned long long distinct[2];
+		checkCudaErrors(cudaMemcpy(distinct, distinctCounts, sizeof(distinct), cudaMemcpyDeviceToHost));
+		stats.materialsBeforeSort = distinct[0];
+		stats.materialsAfterSort = distinct[1];
+	}
+	accumulatedSamples += samplesCount;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "RenderBackend.h"
+#include "Wavefront.h"
+#include "../Raytracing/Scene.h"
+
+//Device version of the wavefront pipeline (see Wavefront.h), one kernel per stage. Live paths are
+//compacted with an atomic counter, the host reads it back to size the next bounce launch.
+//The sort pass is a counting sort with atomic bin offsets, scanned on the device
+class WavefrontCudaRenderer : public RenderBackend
+{
+public:
+	//scene has to outlive the renderer, waveSize - paths per queue
+	WavefrontCudaRenderer(Scene& scene, const Camera& cam, Wavefront::SortMode sortMode = Wavefront::SortMode::None, uint32_t waveSize = 1 << 21);
+	~WavefrontCudaRenderer();
+
+	WavefrontCudaRenderer(const WavefrontCudaRenderer&) = delete;
+	WavefrontCudaRenderer& operator=(const WavefrontCudaRenderer&) = delete;
+
+	void accumulate(uint32_t samplesCount, dataPixels* pixels) override;
+	void resetAccumulation() override;
+	void readRadiance(glm::vec3* radiance) const override;
+	void readAccumulation(glm::vec4* output) const override;
+	const char* getName() const override { return "CUDA wavefront"; }
+
+	//Since the last resetAccumulation, stage times stay 0
+	inline const Wavefront::Stats& getStats() const { return stats; }
+
+private:
+	void traceWave(uint32_t firstPixel, uint32_t pathsCount, uint32_t sample);
+	void sortQueue(const Wavefront::PathQueue& from, uint32_t count, const Wavefront::PathQueue& to);
+	//Adds the distinct materials of every warp sized group to *distinctCount on the device
+	void countDistinctMaterials(const Wavefront::PathQueue& queue, uint32_t count, unsigned long long* distinctCount);
+
+	Scene& scene;
+	Wavefront::SortMode sortMode;
+	uint32_t waveSize;
+
+	unsigned char* queueBuffers[2] = { nullptr, nullptr };
+	Wavefront::PathQueue queues[2];
+	uint32_t* liveCount = nullptr;
+	uint32_t* keyOffsets = nullptr; //sortKeysCount entries
+	unsigned long long* distinctCounts = nullptr; //Materials before and after sorting, Stats reads them after accumulate
+	glm::vec4* accumulation = nullptr;
+	dataPixels* pixels = nullptr;
+	Wavefront::Stats stats;
+};
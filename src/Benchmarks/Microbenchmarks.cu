@@ -0,0 +1,902 @@
+#include "pch.h"
+#include "Microbenchmarks.h"
+
+#include "../Raytracing/HittableList.h"
+#include "../Raytracing/Acceleration/BVH.h"
+#include "../Raytracing/Acceleration/LBVHBuilder.h"
+#include "../Raytracing/Acceleration/WideBVHBuilder.h"
+#include "../Raytracing/Objects/SphereSimd.h"
+#include "../Backends/CpuRenderer.h"
+#include "../Backends/WavefrontCpuRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+namespace {
+	constexpr int repetitions = 5;
+
+	//Every benchmark folds its outputs in here, so the compiler can't drop the measured work
+	volatile float sink = 0.0f;
+
+	struct HitRecord {
+		Ray ray;
+		hitData data;
+	};
+
+	//Best of several runs, body returns a checksum of what it computed
+	template<typename Body>
+	Microbenchmarks::Result measure(const std::string& name, const char* unit, uint64_t opsCount, Body body)
+	{
+		double best = Utils::infinity;
+		for (int r = 0; r < repetitions; r++) {
+			auto start = std::chrono::steady_clock::now();
+			float checksum = body();
+			auto stop = std::chrono::steady_clock::now();
+
+			sink = sink + checksum;
+			best = std::min(best, std::chrono::duration<double>(stop - start).count());
+		}
+
+		return { name, unit, opsCount, best };
+	}
+
+	//Uniformly spread over the image, same sampling as the renderer
+	std::vector<Ray> cameraRays(const Camera& cam, uint32_t count, uint32_t seed)
+	{
+		glm::u32vec2 imgSize = cam.getImageSize();
+		std::vector<Ray> rays;
+		rays.reserve(count);
+		for (uint32_t n = 0; n < count; n++) {
+			Utils::RandState localRandState = Utils::makeRandState(n, 0, seed);
+			uint32_t i = std::min(uint32_t(Utils::generateRandomNumber(&localRandState) * imgSize.x), imgSize.x - 1);
+			uint32_t j = std::min(uint32_t(Utils::generateRandomNumber(&localRandState) * imgSize.y), imgSize.y - 1);
+			rays.push_back(cam.getRay(i, j, &localRandState));
+		}
+		return rays;
+	}
+
+	std::vector<HitRecord> closestHits(const Hittable& world, const std::vector<Ray>& rays)
+	{
+		std::vector<HitRecord> hits;
+		for (const Ray& ray : rays) {
+			hitData data;
+			if (world.hit(ray, Interval(0.001f, Utils::infinity), data))
+				hits.push_back({ ray, data });
+		}
+		return hits;
+	}
+
+	//First diffuse bounce of the camera rays, cycles through the hits until count rays are made
+	std::vector<Ray> diffuseRays(const std::vector<HitRecord>& hits, uint32_t count, uint32_t seed)
+	{
+		std::vector<Ray> rays;
+		if (hits.empty())
+			return rays;
+
+		rays.reserve(count);
+		for (uint32_t n = 0; n < count; n++) {
+			const HitRecord& hit = hits[n % hits.size()];
+			Utils::RandState localRandState = Utils::makeRandState(n, 1, seed);
+			Utils::setBounce(1, &localRandState);
+
+			Ray scattered(glm::vec3(0.0f), glm::vec3(0.0f));
+			glm::vec3 attenuation;
+			Materials::Lambertian::scatter(glm::vec3(0.5f), hit.ray, hit.data, attenuation, scattered, &localRandState);
+			rays.push_back(scattered);
+		}
+		return rays;
+	}
+
+	template<typename World>
+	float traceAll(const World& world, const std::vector<Ray>& rays)
+	{
+		float checksum = 0.0f;
+		for (const Ray& ray : rays) {
+			hitData data;
+			if (world.hit(ray, Interval(0.001f, Utils::infinity), data))
+				checksum += data.t;
+		}
+		return checksum;
+	}
+
+	//HittableList over the same spheres through SphereSimd, the winner's record is filled the way SphereSet fills it
+	struct SimdSphereList {
+		const SphereSimd* simd;
+		SphereSet spheres;
+
+		bool hit(const Ray& r, Interval rayT, hitData& data) const {
+			float t;
+			uint32_t idx = simd->closestHit(r.origin(), r.direction(), rayT._min, rayT._max, t);
+			if (idx == SphereSimd::noHit)
+				return false;
+
+			spheres.hitRecord(idx, 0, r, rayT, t, data);
+			return true;
+		}
+	};
+
+	//SphereSimd promises the linear scan's exact result: the same closest sphere as a scan in HittableList order
+	//and the same distance as HittableList::hit. closest(ray, t) returns the sphere index or SphereSimd::noHit
+	template<typename Closest>
+	uint64_t countMismatches(const HittableList& list, const SphereSet& spheres, const std::vector<Ray>& rays, Closest closest)
+	{
+		uint64_t mismatches = 0;
+		for (size_t r = 0; r < rays.size(); r++) {
+			hitData data;
+			bool hit = list.hit(rays[r], Interval(0.001f, Utils::infinity), data);
+
+			uint32_t expected = SphereSimd::noHit;
+			float closestT = Utils::infinity, t;
+			uint32_t part;
+			for (uint32_t i = 0; i < spheres.size(); i++) {
+				if (spheres.hitDistance(i, rays[r], Interval(0.001f, closestT), t, part)) {
+					closestT = t;
+					expected = i;
+				}
+			}
+
+			uint32_t idx = closest(r, t);
+			if (idx != expected || (hit && t != data.t) || hit != (idx != SphereSimd::noHit))
+				mismatches++;
+		}
+		return mismatches;
+	}
+
+	//Rays in packets of SphereSimd::packetSize, same checksum as traceAll
+	float tracePackets(const SphereSimd& simd, const SphereSet& spheres, const std::vector<glm::vec3>& origins,
+		const std::vector<glm::vec3>& directions, const std::vector<Ray>& rays)
+	{
+		float checksum = 0.0f;
+		float t[SphereSimd::packetSize];
+		uint32_t ids[SphereSimd::packetSize];
+		for (size_t first = 0; first < rays.size(); first += SphereSimd::packetSize) {
+			uint32_t packetRays = uint32_t(std::min<size_t>(SphereSimd::packetSize, rays.size() - first));
+			simd.closestHits(&origins[first], &directions[first], packetRays, 0.001f, Utils::infinity, t, ids);
+			for (uint32_t r = 0; r < packetRays; r++) {
+				if (ids[r] == SphereSimd::noHit)
+					continue;
+				hitData data;
+				spheres.hitRecord(ids[r], 0, rays[first + r], Interval(0.001f, Utils::infinity), t[r], data);
+				checksum += data.t;
+			}
+		}
+		return checksum;
+	}
+
+	struct RouletteRun {
+		std::vector<glm::vec3> radiance;
+		double seconds;
+		uint64_t segments;
+	};
+
+	RouletteRun renderWavefront(const Scene& scene, const Camera& cam, uint32_t threadsCount)
+	{
+		glm::u32vec2 imgSize = cam.getImageSize();
+		WavefrontCpuRenderer renderer(scene, cam, threadsCount);
+		std::vector<dataPixels> pixels(imgSize.x * imgSize.y);
+
+		auto start = std::chrono::steady_clock::now();
+		renderer.render(pixels.data());
+		auto stop = std::chrono::steady_clock::now();
+
+		RouletteRun run;
+		run.radiance.resize(pixels.size());
+		renderer.readRadiance(run.radiance.data());
+		run.seconds = std::chrono::duration<double>(stop - start).count();
+		run.segments = renderer.getStats().pathsShaded;
+		return run;
+	}
+
+	//Mean over pixels and channels of squared error relative to the squared reference, so dark and bright pixels weigh alike
+	double relativeMSE(const std::vector<glm::vec3>& image, const std::vector<glm::vec3>& reference)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < image.size(); i++) {
+			for (int c = 0; c < 3; c++) {
+				double difference = double(image[i][c]) - reference[i][c];
+				sum += difference * difference / (double(reference[i][c]) * reference[i][c] + 0.01);
+			}
+		}
+		return image.empty() ? 0.0 : sum / (3.0 * image.size());
+	}
+
+	double rootMeanSquaredError(const std::vector<glm::vec3>& image, const std::vector<glm::vec3>& reference)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < image.size(); i++) {
+			glm::dvec3 difference = glm::dvec3(image[i]) - glm::dvec3(reference[i]);
+			sum += glm::dot(difference, difference);
+		}
+		return image.empty() ? 0.0 : std::sqrt(sum / (3.0 * image.size()));
+	}
+
+	//Spheres spread evenly through a cube, about half a radius apart on average, so there is no structure a builder could exploit
+	struct RandomSpheres {
+		std::vector<glm::vec3> centers;
+		std::vector<float> radii;
+		std::vector<uint32_t> materialIds;
+
+		SphereSet view() const {
+			SphereSet set;
+			set.centers = centers.data();
+			set.radii = radii.data();
+			set.materialIds = materialIds.data();
+			set.count = static_cast<uint32_t>(centers.size());
+			return set;
+		}
+	};
+
+	RandomSpheres randomSpheres(uint32_t count, float size, uint32_t seed)
+	{
+		RandomSpheres spheres;
+		float radius = 0.25f * size / std::cbrt(float(count));
+		for (uint32_t n = 0; n < count; n++) {
+			Utils::RandState localRandState = Utils::makeRandState(n, 4, seed);
+			glm::vec3 unit(Utils::generateRandomNumber(&localRandState), Utils::generateRandomNumber(&localRandState),
+				Utils::generateRandomNumber(&localRandState));
+			spheres.centers.push_back((unit - 0.5f) * size);
+			spheres.radii.push_back(radius * (0.5f + Utils::generateRandomNumber(&localRandState)));
+		}
+		spheres.materialIds.assign(count, 0);
+		return spheres;
+	}
+
+	//Origins anywhere inside the sphere box, uniform directions
+	std::vector<Ray> randomRays(uint32_t count, float size, uint32_t seed)
+	{
+		std::vector<Ray> rays;
+		rays.reserve(count);
+		for (uint32_t n = 0; n < count; n++) {
+			Utils::RandState localRandState = Utils::makeRandState(n, 5, seed);
+			glm::vec3 origin(Utils::generateRandomNumber(&localRandState), Utils::generateRandomNumber(&localRandState),
+				Utils::generateRandomNumber(&localRandState));
+			rays.push_back(Ray((origin - 0.5f) * size, Utils::Vector::randomInUnitSphereVector(&localRandState)));
+		}
+		return rays;
+	}
+
+	//x moving at speed bounces between -half and half
+	float bounce(float x, float half)
+	{
+		float period = 4.0f * half;
+		float phase = std::fmod(x + half, period);
+		if (phase < 0.0f)
+			phase += period;
+		return phase < 2.0f * half ? phase - half : 3.0f * half - phase;
+	}
+
+	template<typename T>
+	std::vector<T> reordered(const std::vector<T>& data, const std::vector<uint32_t>& order)
+	{
+		std::vector<T> result(order.size());
+		for (size_t i = 0; i < order.size(); i++)
+			result[i] = data[order[i]];
+		return result;
+	}
+
+	//sample(randState) returns a value to fold into the checksum, RandState::counter tells how many numbers it drew
+	template<typename Sample>
+	Microbenchmarks::Result samplingBenchmark(const std::string& name, uint32_t samplesCount, uint32_t seed, Sample sample)
+	{
+		Microbenchmarks::Result result = measure(name, "samples", samplesCount, [&]() {
+			float checksum = 0.0f;
+			for (uint32_t n = 0; n < samplesCount; n++) {
+				Utils::RandState localRandState = Utils::makeRandState(n, 3, seed);
+				checksum += sample(&localRandState);
+			}
+			return checksum;
+		});
+
+		uint64_t draws = 0;
+		for (uint32_t n = 0; n < samplesCount; n++) {
+			Utils::RandState localRandState = Utils::makeRandState(n, 3, seed);
+			sample(&localRandState);
+			draws += localRandState.counter;
+		}
+		result.drawsPerOp = samplesCount > 0 ? double(draws) / samplesCount : 0.0;
+		return result;
+	}
+
+	//scatter(ray, hit, attenuation, scattered, randState) for every recorded hit
+	template<typename Scatter>
+	float scatterAll(const std::vector<HitRecord>& hits, uint32_t seed, Scatter scatter)
+	{
+		float checksum = 0.0f;
+		for (uint32_t n = 0; n < hits.size(); n++) {
+			Utils::RandState localRandState = Utils::makeRandState(n, 2, seed);
+			Ray scattered(glm::vec3(0.0f), glm::vec3(0.0f));
+			glm::vec3 attenuation;
+			if (scatter(hits[n].ray, hits[n].data, attenuation, scattered, &localRandState))
+				checksum += scattered.direction().x + attenuation.r;
+		}
+		return checksum;
+	}
+}
+
+std::vector<Microbenchmarks::Result> Microbenchmarks::run(const Scene& scene, const Camera& cam, uint32_t raysCount, uint32_t seed)
+{
+	std::vector<Result> results;
+
+	BVH<ScenePrimitives> bvh(scene.getNodes().data(), scene.getNodesCount(), scene.getHostPrimitives(nullptr));
+	MaterialTable materials = scene.getHostMaterialTable();
+
+	//Same spheres as plain objects for the linear scan
+	SphereSet spheres = scene.getHostSpheres(nullptr);
+	Hittable** objects = new Hittable*[spheres.size()];
+	for (uint32_t i = 0; i < spheres.size(); i++)
+		objects[i] = new Sphere(spheres.centers[i], spheres.radii[i], nullptr, spheres.materialIds[i]);
+	HittableList list(objects, spheres.size());
+
+	std::vector<Ray> camera = cameraRays(cam, raysCount, seed);
+	std::vector<HitRecord> cameraHits = closestHits(bvh, camera);
+	std::vector<Ray> diffuse = diffuseRays(cameraHits, raysCount, seed);
+	std::vector<HitRecord> hits = cameraHits;
+	std::vector<HitRecord> diffuseHits = closestHits(bvh, diffuse);
+	hits.insert(hits.end(), diffuseHits.begin(), diffuseHits.end());
+
+	//Every camera ray against every sphere, ray count trimmed so it stays close to raysCount tests
+	if (spheres.size() > 0) {
+		uint32_t sphereRays = std::max(1u, raysCount / spheres.size());
+		results.push_back(measure("Sphere::hit (camera)", "tests", uint64_t(sphereRays) * spheres.size(), [&]() {
+			float checksum = 0.0f;
+			for (uint32_t r = 0; r < sphereRays; r++) {
+				for (uint32_t i = 0; i < spheres.size(); i++) {
+					hitData data;
+					if (objects[i]->hit(camera[r], Interval(0.001f, Utils::infinity), data))
+						checksum += data.t;
+				}
+			}
+			return checksum;
+		}));
+	}
+
+	results.push_back(measure("HittableList::hit (camera)", "rays", camera.size(), [&]() { return traceAll(list, camera); }));
+	results.push_back(measure("HittableList::hit (diffuse)", "rays", diffuse.size(), [&]() { return traceAll(list, diffuse); }));
+
+	//Same linear scan over the spheres with every instruction set this CPU has, the scalar fallback included
+	for (int isa = 0; isa <= int(SphereSimd::bestIsa()); isa++) {
+		SphereSimd simd(spheres.centers, spheres.radii, spheres.size(), SphereSimd::Isa(isa));
+		SimdSphereList simdList = { &simd, spheres };
+		std::string name = std::string("SphereSimd ") + SphereSimd::name(simd.getIsa());
+		results.push_back(measure(name + " (camera)", "rays", camera.size(), [&]() { return traceAll(simdList, camera); }));
+		results.back().mismatches = countMismatches(list, spheres, camera, [&](size_t r, float& t) {
+			return simd.closestHit(camera[r].origin(), camera[r].direction(), 0.001f, Utils::infinity, t);
+		});
+		results.push_back(measure(name + " (diffuse)", "rays", diffuse.size(), [&]() { return traceAll(simdList, diffuse); }));
+		results.back().mismatches = countMismatches(list, spheres, diffuse, [&](size_t r, float& t) {
+			return simd.closestHit(diffuse[r].origin(), diffuse[r].direction(), 0.001f, Utils::infinity, t);
+		});
+	}
+
+	//Camera rays 8 at a time against one sphere at a time
+	SphereSimd simd(spheres.centers, spheres.radii, spheres.size());
+	if (simd.getIsa() != SphereSimd::Isa::Scalar) {
+		std::vector<glm::vec3> origins, directions;
+		for (const Ray& ray : camera) {
+			origins.push_back(ray.origin());
+			directions.push_back(ray.direction());
+		}
+		results.push_back(measure("SphereSimd 8 ray packets (camera)", "rays", camera.size(), [&]() {
+			return tracePackets(simd, spheres, origins, directions, camera);
+		}));
+
+		std::vector<float> packetT(camera.size());
+		std::vector<uint32_t> packetIds(camera.size());
+		for (size_t first = 0; first < camera.size(); first += SphereSimd::packetSize) {
+			uint32_t packetRays = uint32_t(std::min<size_t>(SphereSimd::packetSize, camera.size() - first));
+			simd.closestHits(&origins[first], &directions[first], packetRays, 0.001f, Utils::infinity, &packetT[first], &packetIds[first]);
+		}
+		results.back().mismatches = countMismatches(list, spheres, camera, [&](size_t r, float& t) {
+			t = packetT[r];
+			return packetIds[r];
+		});
+	}
+	results.push_back(measure("BVH<ScenePrimitives>::hit (camera)", "rays", camera.size(), [&]() { return traceAll(bvh, camera); }));
+	results.push_back(measure("BVH<ScenePrimitives>::hit (diffuse)", "rays", diffuse.size(), [&]() { return traceAll(bvh, diffuse); }));
+
+	//Closed form samplers next to the rejection loops they replaced
+	results.push_back(samplingBenchmark("Vector::randomInUnitSphere", raysCount, seed, [](Utils::RandState* localRandState) {
+		return Utils::Vector::randomInUnitSphere(localRandState).x;
+	}));
+	results.push_back(samplingBenchmark("Vector::randomInUnitSphereRejection", raysCount, seed, [](Utils::RandState* localRandState) {
+		return Utils::Vector::randomInUnitSphereRejection(localRandState).x;
+	}));
+	results.push_back(samplingBenchmark("Vector::randomInUnitSphereVector", raysCount, seed, [](Utils::RandState* localRandState) {
+		return Utils::Vector::randomInUnitSphereVector(localRandState).x;
+	}));
+	results.push_back(samplingBenchmark("normalize(randomInUnitSphereRejection)", raysCount, seed, [](Utils::RandState* localRandState) {
+		return glm::normalize(Utils::Vector::randomInUnitSphereRejection(localRandState)).x;
+	}));
+	results.push_back(samplingBenchmark("Vector::randomInUnitDisk", raysCount, seed, [](Utils::RandState* localRandState) {
+		return Utils::Vector::randomInUnitDisk(localRandState).x;
+	}));
+	results.push_back(samplingBenchmark("Vector::randomInUnitDiskRejection", raysCount, seed, [](Utils::RandState* localRandState) {
+		return Utils::Vector::randomInUnitDiskRejection(localRandState).x;
+	}));
+	results.push_back(samplingBenchmark("Vector::randomCosineHemisphere", raysCount, seed, [](Utils::RandState* localRandState) {
+		return Utils::Vector::randomCosineHemisphere(glm::vec3(0.0f, 1.0f, 0.0f), localRandState).x;
+	}));
+
+	//Fixed parameters so each material runs on all hits, MaterialTable uses the scene materials
+	results.push_back(measure("Lambertian::scatter", "scatters", hits.size(), [&]() {
+		return scatterAll(hits, seed, [](const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& scattered, Utils::RandState* localRandState) {
+			return Materials::Lambertian::scatter(glm::vec3(0.5f), rayIn, data, attenuation, scattered, localRandState);
+		});
+	}));
+	results.push_back(measure("Metal::scatter", "scatters", hits.size(), [&]() {
+		return scatterAll(hits, seed, [](const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& scattered, Utils::RandState* localRandState) {
+			return Materials::Metal::scatter(glm::vec3(0.7f, 0.6f, 0.5f), 0.3f, rayIn, data, attenuation, scattered, localRandState);
+		});
+	}));
+	results.push_back(measure("Dielectric::scatter", "scatters", hits.size(), [&]() {
+		return scatterAll(hits, seed, [](const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& scattered, Utils::RandState* localRandState) {
+			return Materials::Dielectric::scatter(1.5f, rayIn, data, attenuation, scattered, localRandState);
+		});
+	}));
+	results.push_back(measure("MaterialTable::scatter", "scatters", hits.size(), [&]() {
+		return scatterAll(hits, seed, [&](const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& scattered, Utils::RandState* localRandState) {
+			return materials.scatter(rayIn, data, attenuation, scattered, localRandState);
+		});
+	}));
+
+	//Same hits grouped by material type like the wavefront sort pass, A/B against the row above
+	std::vector<HitRecord> sortedHits = hits;
+	std::stable_sort(sortedHits.begin(), sortedHits.end(), [&](const HitRecord& a, const HitRecord& b) {
+		return materials.materials[a.data.materialId].type < materials.materials[b.data.materialId].type;
+	});
+	results.push_back(measure("MaterialTable::scatter (sorted)", "scatters", sortedHits.size(), [&]() {
+		return scatterAll(sortedHits, seed, [&](const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& scattered, Utils::RandState* localRandState) {
+			return materials.scatter(rayIn, data, attenuation, scattered, localRandState);
+		});
+	}));
+
+	//HittableList only frees the pointer array
+	for (uint32_t i = 0; i < spheres.size(); i++)
+		delete objects[i];
+
+	return results;
+}
+
+void Microbenchmarks::print(const std::vector<Result>& results)
+{
+	std::cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(12) << "ops"
+		<< std::setw(12) << "ns/op" << std::setw(20) << "throughput" << std::setw(12) << "draws/op" << "\n";
+
+	for (const Result& result : results) {
+		std::cout << std::left << std::setw(40) << result.name << std::right << std::setw(12) << result.opsCount
+			<< std::setw(12) << std::fixed << std::setprecision(2) << result.nsPerOp()
+			<< std::setw(12) << result.opsPerSecond() / 1e6 << std::left << std::setw(8) << (" M" + std::string(result.unit) + "/s")
+			<< std::right << std::setw(12);
+		if (result.drawsPerOp > 0.0)
+			std::cout << result.drawsPerOp;
+		else
+			std::cout << "-";
+		if (result.mismatches > 0)
+			std::cout << "  " << result.mismatches << " mismatches FAIL";
+		std::cout << "\n";
+	}
+	std::cout.unsetf(std::ios::floatfield);
+}
+
+bool Microbenchmarks::RouletteComparison::unbiased() const
+{
+	glm::dvec3 difference = glm::abs(meanWith - meanWithout);
+	return difference.r <= 4.0 * standardError.r && difference.g <= 4.0 * standardError.g && difference.b <= 4.0 * standardError.b;
+}
+
+Microbenchmarks::RouletteComparison Microbenchmarks::compareRoulette(const Scene& scene, const Camera& cam, uint32_t threadsCount)
+{
+	Camera withoutRoulette = cam;
+	withoutRoulette.setRouletteDepth(0);
+
+	RouletteRun without = renderWavefront(scene, withoutRoulette, threadsCount);
+	RouletteRun with = renderWavefront(scene, cam, threadsCount);
+
+	//Both renders share their random streams up to termination, so the per pixel difference is what carries the noise
+	size_t pixelsCount = without.radiance.size();
+	glm::dvec3 sumWithout(0.0), sumWith(0.0), sumDifference(0.0), sumDifferenceSquared(0.0);
+	for (size_t i = 0; i < pixelsCount; i++) {
+		glm::dvec3 difference = glm::dvec3(with.radiance[i]) - glm::dvec3(without.radiance[i]);
+		sumWithout += glm::dvec3(without.radiance[i]);
+		sumWith += glm::dvec3(with.radiance[i]);
+		sumDifference += difference;
+		sumDifferenceSquared += difference * difference;
+	}
+
+	double n = double(pixelsCount);
+	glm::dvec3 meanDifference = sumDifference / n;
+	glm::dvec3 variance = glm::max(sumDifferenceSquared / n - meanDifference * meanDifference, glm::dvec3(0.0));
+	uint64_t paths = uint64_t(pixelsCount) * cam.getPerPixelSamples();
+
+	RouletteComparison comparison;
+	comparison.rouletteDepth = cam.getRouletteDepth();
+	comparison.meanWithout = sumWithout / n;
+	comparison.meanWith = sumWith / n;
+	comparison.standardError = glm::sqrt(variance / n);
+	comparison.segmentsWithout = double(without.segments) / paths;
+	comparison.segmentsWith = double(with.segments) / paths;
+	comparison.secondsWithout = without.seconds;
+	comparison.secondsWith = with.seconds;
+	comparison.raysWithout = without.segments;
+	comparison.raysWith = with.segments;
+	return comparison;
+}
+
+void Microbenchmarks::print(const RouletteComparison& comparison)
+{
+	auto printMean = [](const glm::dvec3& mean) {
+		std::cout << "(" << mean.r << ", " << mean.g << ", " << mean.b << ")";
+	};
+
+	std::cout << std::fixed << std::setprecision(4) << "Russian roulette after " << comparison.rouletteDepth << " bounces\n";
+	std::cout << "  mean radiance    without ";
+	printMean(comparison.meanWithout);
+	std::cout << ", with ";
+	printMean(comparison.meanWith);
+	std::cout << "\n" << std::scientific << std::setprecision(2) << "  difference       ";
+	printMean(comparison.meanWith - comparison.meanWithout);
+	std::cout << ", standard error ";
+	printMean(comparison.standardError);
+	std::cout << (comparison.unbiased() ? " - unbiased" : " - BIASED") << "\n" << std::fixed;
+
+	std::cout << std::setprecision(2) << "  path length      " << comparison.segmentsWithout << " -> " << comparison.segmentsWith << " segments\n"
+		<< "  render time      " << comparison.secondsWithout << " -> " << comparison.secondsWith << " s ("
+		<< comparison.secondsWithout / comparison.secondsWith << "x)\n"
+		<< "  rays per second  " << comparison.raysWithout / comparison.secondsWithout / 1e6 << " -> "
+		<< comparison.raysWith / comparison.secondsWith / 1e6 << " M\n";
+	std::cout.unsetf(std::ios::floatfield);
+}
+
+Microbenchmarks::Reference Microbenchmarks::renderReference(const Scene& scene, const Camera& cam, uint32_t samplesPerPixel, uint32_t threadsCount)
+{
+	const uint32_t firstSample = 1u << 20;
+	Camera referenceCam = cam;
+	referenceCam.setSampler(Utils::Sampler::Independent);
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	BVH<ScenePrimitives> bvh(scene.getNodes().data(), scene.getNodesCount(), scene.getHostPrimitives(nullptr));
+	MaterialTable materials = scene.getHostMaterialTable();
+	Hittable* worldPtr = &bvh;
+
+	Reference reference;
+	reference.samplesPerPixel = samplesPerPixel;
+	reference.radiance.resize(size_t(imgSize.x) * imgSize.y);
+	ThreadPool pool(threadsCount);
+	pool.parallelFor(imgSize.y, [&](uint32_t j, uint32_t) {
+		for (uint32_t i = 0; i < imgSize.x; i++)
+			reference.radiance[i + j * imgSize.x] = referenceCam.samplePixel(i, j, firstSample, samplesPerPixel, &worldPtr, materials)
+				/ float(samplesPerPixel);
+	});
+	return reference;
+}
+
+Microbenchmarks::AdaptiveComparison Microbenchmarks::compareAdaptive(const Scene& scene, const Camera& cam, const Adaptive::Settings& settings,
+	const Reference& reference, uint32_t threadsCount)
+{
+	AdaptiveComparison comparison;
+	comparison.settings = settings;
+	comparison.referenceSamples = reference.samplesPerPixel;
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	size_t pixelsCount = size_t(imgSize.x) * imgSize.y;
+	CpuRenderer renderer(scene, cam, threadsCount);
+
+	std::vector<dataPixels> pixels(pixelsCount);
+	std::vector<glm::vec3> radiance(pixelsCount);
+	for (uint32_t spp = 4; spp <= uint32_t(cam.getPerPixelSamples()); spp *= 2) {
+		AdaptiveResult result;
+		result.samplesPerPixel = spp;
+
+		auto start = std::chrono::steady_clock::now();
+		renderer.resetAccumulation();
+		renderer.accumulate(spp, pixels.data());
+		result.uniformSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		renderer.readRadiance(radiance.data());
+		result.uniformError = relativeMSE(radiance, reference.radiance);
+
+		Adaptive::Settings budget = settings;
+		budget.samplesPerPixel = spp;
+		start = std::chrono::steady_clock::now();
+		uint64_t taken = renderer.renderAdaptive(budget, pixels.data());
+		result.adaptiveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		renderer.readRadiance(radiance.data());
+		result.adaptiveError = relativeMSE(radiance, reference.radiance);
+		result.adaptiveSamplesPerPixel = double(taken) / pixelsCount;
+
+		comparison.results.push_back(result);
+	}
+
+	return comparison;
+}
+
+void Microbenchmarks::print(const AdaptiveComparison& comparison)
+{
+	std::cout << "Adaptive sampling, threshold " << comparison.settings.threshold << ", relative MSE against " << comparison.referenceSamples
+		<< " spp\n" << std::right << std::setw(8) << "spp" << std::setw(14) << "uniform s" << std::setw(14) << "uniform err"
+		<< std::setw(14) << "adaptive spp" << std::setw(14) << "adaptive s" << std::setw(14) << "adaptive err" << std::setw(10) << "ratio" << "\n";
+
+	for (const AdaptiveResult& result : comparison.results) {
+		std::cout << std::setw(8) << result.samplesPerPixel << std::fixed << std::setprecision(3) << std::setw(14) << result.uniformSeconds
+			<< std::scientific << std::setprecision(3) << std::setw(14) << result.uniformError
+			<< std::fixed << std::setprecision(2) << std::setw(14) << result.adaptiveSamplesPerPixel
+			<< std::setprecision(3) << std::setw(14) << result.adaptiveSeconds
+			<< std::scientific << std::setw(14) << result.adaptiveError
+			<< std::fixed << std::setprecision(2) << std::setw(10) << (result.adaptiveError > 0.0 ? result.uniformError / result.adaptiveError : 0.0)
+			<< "\n";
+	}
+	std::cout.unsetf(std::ios::floatfield);
+}
+
+Microbenchmarks::SamplerComparison Microbenchmarks::compareSamplers(const Scene& scene, const Camera& cam, const Reference& reference,
+	uint32_t threadsCount)
+{
+	SamplerComparison comparison;
+	comparison.referenceSamples = reference.samplesPerPixel;
+
+	glm::u32vec2 imgSize = cam.getImageSize();
+	std::vector<dataPixels> pixels(size_t(imgSize.x) * imgSize.y);
+	std::vector<glm::vec3> radiance(pixels.size());
+
+	Camera independentCam = cam, sobolCam = cam;
+	independentCam.setSampler(Utils::Sampler::Independent);
+	sobolCam.setSampler(Utils::Sampler::Sobol);
+	CpuRenderer independent(scene, independentCam, threadsCount);
+	CpuRenderer sobol(scene, sobolCam, threadsCount);
+
+	auto measureRender = [&](CpuRenderer& renderer, uint32_t spp, double& seconds, double& error) {
+		auto start = std::chrono::steady_clock::now();
+		renderer.resetAccumulation();
+		renderer.accumulate(spp, pixels.data());
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		renderer.readRadiance(radiance.data());
+		error = rootMeanSquaredError(radiance, reference.radiance);
+	};
+
+	for (uint32_t spp = 1; spp <= uint32_t(cam.getPerPixelSamples()); spp *= 2) {
+		SamplerResult result;
+		result.samplesPerPixel = spp;
+		measureRender(independent, spp, result.independentSeconds, result.independentError);
+		measureRender(sobol, spp, result.sobolSeconds, result.sobolError);
+		comparison.results.push_back(result);
+	}
+
+	return comparison;
+}
+
+void Microbenchmarks::print(const SamplerComparison& comparison)
+{
+	//At the Monte Carlo rate squared error falls as 1 / spp, so the MSE ratio is how many times more independent samples match Sobol
+	std::cout << "Samplers, RMSE against " << comparison.referenceSamples << " spp\n" << std::right << std::setw(8) << "spp"
+		<< std::setw(14) << "independent s" << std::setw(16) << "independent err" << std::setw(10) << "sobol s" << std::setw(14) << "sobol err"
+		<< std::setw(12) << "MSE ratio" << "\n";
+
+	for (const SamplerResult& result : comparison.results) {
+		double ratio = result.sobolError > 0.0 ? (result.independentError * result.independentError) / (result.sobolError * result.sobolError) : 0.0;
+		std::cout << std::setw(8) << result.samplesPerPixel << std::fixed << std::setprecision(3) << std::setw(14) << result.independentSeconds
+			<< std::scientific << std::setw(16) << result.independentError
+			<< std::fixed << std::setw(10) << result.sobolSeconds
+			<< std::scientific << std::setw(14) << result.sobolError
+			<< std::fixed << std::setprecision(2) << std::setw(12) << ratio << "\n";
+	}
+	std::cout.unsetf(std::ios::floatfield);
+}
+
+std::vector<Microbenchmarks::BuilderResult> Microbenchmarks::compareBuilders(const std::vector<uint32_t>& sizes, uint32_t raysCount,
+	uint32_t threadsCount, uint32_t seed)
+{
+	constexpr float size = 100.0f;
+	std::vector<Ray> rays = randomRays(raysCount, size, seed);
+
+	BVHBuilder sah;
+	LBVHBuilder lbvh30(threadsCount, LBVH::MortonBits::Bits30);
+	LBVHBuilder lbvh63(threadsCount, LBVH::MortonBits::Bits63);
+
+	std::vector<BuilderResult> results;
+	for (uint32_t count : sizes) {
+		RandomSpheres spheres = randomSpheres(count, size, seed);
+		std::vector<AABB> bounds(count);
+		for (uint32_t i = 0; i < count; i++)
+			bounds[i] = spheres.view().boundingBox(i);
+
+		auto run = [&](const std::string& name, auto& builder) {
+			Result build = measure(name, "builds", 1, [&]() {
+				builder.build(bounds);
+				return builder.getNodes()[0].bounds._max.x;
+			});
+
+			RandomSpheres sorted;
+			sorted.centers = reordered(spheres.centers, builder.getPrimitiveIndices());
+			sorted.radii = reordered(spheres.radii, builder.getPrimitiveIndices());
+			sorted.materialIds = spheres.materialIds;
+			BVH<SphereSet> bvh(builder.getNodes().data(), static_cast<int>(builder.getNodes().size()), sorted.view());
+			Result trace = measure(name, "rays", rays.size(), [&]() { return traceAll(bvh, rays); });
+
+			results.push_back({ count, name, build.seconds, trace.opsPerSecond(), BVHBuilder::sahCost(builder.getNodes()), builder.getDepth() });
+		};
+		run("SAH", sah);
+		run("LBVH 30", lbvh30);
+		run("LBVH 63", lbvh63);
+	}
+
+	return results;
+}
+
+void Microbenchmarks::print(const std::vector<BuilderResult>& results)
+{
+	std::cout << "BVH builders, random spheres\n" << std::right << std::setw(10) << "spheres" << std::setw(10) << "builder"
+		<< std::setw(12) << "build ms" << std::setw(12) << "Mrays/s" << std::setw(12) << "SAH cost" << std::setw(8) << "depth" << "\n";
+
+	for (const BuilderResult& result : results) {
+		std::cout << std::setw(10) << result.primitivesCount << std::setw(10) << result.builder << std::fixed << std::setprecision(2)
+			<< std::setw(12) << result.buildSeconds * 1e3 << std::setw(12) << result.raysPerSecond / 1e6
+			<< std::setw(12) << result.sahCost << std::setw(8) << result.depth << "\n";
+	}
+	std::cout.unsetf(std::ios::floatfield);
+}
+
+Microbenchmarks::RefitComparison Microbenchmarks::compareRefit(uint32_t spheresCount, uint32_t framesCount, uint32_t raysCount,
+	uint32_t threadsCount, float maxCostRatio, uint32_t seed)
+{
+	constexpr float size = 100.0f;
+	RandomSpheres spheres = randomSpheres(spheresCount, size, seed);
+	std::vector<Ray> rays = randomRays(raysCount, size, seed);
+
+	std::vector<glm::vec3> velocities(spheresCount);
+	for (uint32_t n = 0; n < spheresCount; n++) {
+		Utils::RandState localRandState = Utils::makeRandState(n, 6, seed);
+		velocities[n] = Utils::Vector::randomInUnitSphereVector(&localRandState) * 0.1f * spheres.radii[n];
+	}
+
+	//refitted - refitBVH only, updated - updateBVH, rebuilt - built from scratch for the last frame
+	Scene refitted, updated, rebuilt;
+	for (Scene* scene : { &refitted, &updated, &rebuilt }) {
+		uint32_t materialId = scene->addMaterial(MaterialData::lambertian(glm::vec3(0.5f)));
+		for (uint32_t n = 0; n < spheresCount; n++)
+			scene->addSphere(spheres.centers[n], spheres.radii[n], materialId);
+	}
+
+	BVHBuilder builder;
+	BVHRefitter refitter(threadsCount);
+	refitted.buildBVH(builder);
+	updated.buildBVH(builder);
+
+	RefitComparison comparison;
+	comparison.spheresCount = spheresCount;
+	comparison.framesCount = framesCount;
+	comparison.maxCostRatio = maxCostRatio;
+	comparison.refitSeconds = 0.0;
+	comparison.updateSeconds = 0.0;
+	comparison.rebuilds = 0;
+
+	float half = 0.5f * size;
+	auto move = [&](Scene& scene, uint32_t frame) {
+		for (uint32_t n = 0; n < spheresCount; n++) {
+			glm::vec3 p = spheres.centers[n] + velocities[n] * float(frame);
+			scene.setSphereCenter(n, glm::vec3(bounce(p.x, half), bounce(p.y, half), bounce(p.z, half)));
+		}
+	};
+
+	for (uint32_t frame = 1; frame <= framesCount; frame++) {
+		move(refitted, frame);
+		auto start = std::chrono::steady_clock::now();
+		comparison.costRatios.push_back(refitted.refitBVH(refitter));
+		comparison.refitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		move(updated, frame);
+		start = std::chrono::steady_clock::now();
+		comparison.rebuilds += updated.updateBVH(refitter, builder, maxCostRatio) ? 1 : 0;
+		comparison.updateSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	comparison.refitSeconds /= std::max(framesCount, 1u);
+	comparison.updateSeconds /= std::max(framesCount, 1u);
+
+	move(rebuilt, framesCount);
+	LBVHBuilder linearBuilder(threadsCount);
+	comparison.lbvhSeconds = measure("LBVH", "builds", 1, [&]() { rebuilt.buildBVH(linearBuilder); return 0.0f; }).seconds;
+	comparison.sahSeconds = measure("SAH", "builds", 1, [&]() { rebuilt.buildBVH(builder); return 0.0f; }).seconds;
+
+	auto raysPerSecond = [&](const Scene& scene) {
+		BVH<SphereSet> bvh(scene.getNodes().data(), scene.getNodesCount(), scene.getHostSpheres(nullptr));
+		return measure("trace", "rays", rays.size(), [&]() { return traceAll(bvh, rays); }).opsPerSecond();
+	};
+	comparison.refitRaysPerSecond = raysPerSecond(refitted);
+	comparison.rebuiltRaysPerSecond = raysPerSecond(rebuilt);
+	return comparison;
+}
+
+void Microbenchmarks::print(const RefitComparison& comparison)
+{
+	std::cout << "Refit, " << comparison.spheresCount << " moving spheres, " << comparison.framesCount << " frames\n" << std::fixed
+		<< std::setprecision(2) << "  full rebuild: SAH " << comparison.sahSeconds * 1e3 << " ms, LBVH " << comparison.lbvhSeconds * 1e3 << " ms\n"
+		<< "  refit: " << comparison.refitSeconds * 1e3 << " ms per frame, SAH cost ratio after";
+	for (size_t frame = 1; frame <= comparison.costRatios.size(); frame *= 2)
+		std::cout << " " << frame << ": " << comparison.costRatios[frame - 1];
+	if (!comparison.costRatios.empty())
+		std::cout << " " << comparison.costRatios.size() << ": " << comparison.costRatios.back();
+	std::cout << "\n  updateBVH (rebuild above " << comparison.maxCostRatio << "): " << comparison.updateSeconds * 1e3 << " ms per frame, "
+		<< comparison.rebuilds << " rebuilds\n"
+		<< "  trace after the last frame: refitted " << comparison.refitRaysPerSecond / 1e6 << " Mrays/s, rebuilt "
+		<< comparison.rebuiltRaysPerSecond / 1e6 << " Mrays/s\n";
+	std::cout.unsetf(std::ios::floatfield);
+}
+
+std::vector<Microbenchmarks::WideResult> Microbenchmarks::compareWidths(const std::vector<uint32_t>& sizes, uint32_t raysCount, uint32_t seed)
+{
+	constexpr float size = 100.0f;
+	std::vector<Ray> rays = randomRays(raysCount, size, seed);
+	BVHBuilder builder;
+
+	std::vector<WideResult> results;
+	for (uint32_t count : sizes) {
+		RandomSpheres spheres = randomSpheres(count, size, seed);
+		std::vector<AABB> bounds(count);
+		for (uint32_t i = 0; i < count; i++)
+			bounds[i] = spheres.view().boundingBox(i);
+		builder.build(bounds);
+
+		RandomSpheres sorted;
+		sorted.centers = reordered(spheres.centers, builder.getPrimitiveIndices());
+		sorted.radii = reordered(spheres.radii, builder.getPrimitiveIndices());
+		sorted.materialIds = spheres.materialIds;
+
+		//Steps are counted in a pass of their own, the timed one runs without counters. Closest hits of the binary
+		//tree (the first run) are the reference every other layout has to find exactly
+		std::vector<float> reference(rays.size());
+		auto run = [&](int width, bool quantized, const auto& bvh, size_t nodesCount, size_t nodeSize) {
+			TraversalStats stats;
+			uint64_t missed = 0;
+			for (size_t i = 0; i < rays.size(); i++) {
+				float t;
+				uint32_t prim, part;
+				if (!bvh.template findClosest<true>(rays[i], Interval(0.001f, Utils::infinity), t, prim, part, &stats))
+					t = Utils::infinity;
+				if (width == 2)
+					reference[i] = t;
+				missed += t != reference[i] ? 1 : 0;
+			}
+			Result trace = measure("trace", "rays", rays.size(), [&]() { return traceAll(bvh, rays); });
+
+			double n = double(std::max<size_t>(rays.size(), 1));
+			results.push_back({ count, width, quantized, nodesCount, nodesCount * nodeSize, stats.nodes / n, stats.boxTests / n,
+				stats.primitiveTests / n, trace.opsPerSecond(), missed });
+		};
+
+		const std::vector<BVHNode>& nodes = builder.getNodes();
+		run(2, false, BVH<SphereSet>(nodes.data(), static_cast<int>(nodes.size()), sorted.view()), nodes.size(), sizeof(BVHNode));
+
+		std::vector<WideBVHNode<4>> nodes4 = WideBVHBuilder::collapse<4>(nodes);
+		run(4, false, WideBVH<SphereSet, 4>(nodes4.data(), static_cast<int>(nodes4.size()), sorted.view()), nodes4.size(), sizeof(WideBVHNode<4>));
+		std::vector<QuantizedBVHNode<4>> quantized4;
+		if (WideBVHBuilder::quantize(nodes4, quantized4)) {
+			run(4, true, QuantizedBVH<SphereSet, 4>(quantized4.data(), static_cast<int>(quantized4.size()), sorted.view()), quantized4.size(),
+				sizeof(QuantizedBVHNode<4>));
+		}
+
+		std::vector<WideBVHNode<8>> nodes8 = WideBVHBuilder::collapse<8>(nodes);
+		run(8, false, WideBVH<SphereSet, 8>(nodes8.data(), static_cast<int>(nodes8.size()), sorted.view()), nodes8.size(), sizeof(WideBVHNode<8>));
+		std::vector<QuantizedBVHNode<8>> quantized8;
+		if (WideBVHBuilder::quantize(nodes8, quantized8)) {
+			run(8, true, QuantizedBVH<SphereSet, 8>(quantized8.data(), static_cast<int>(quantized8.size()), sorted.view()), quantized8.size(),
+				sizeof(QuantizedBVHNode<8>));
+		}
+	}
+
+	return results;
+}
+
+void Microbenchmarks::print(const std::vector<WideResult>& results)
+{
+	std::cout << "BVH width, random spheres, SAH\n" << std::right << std::setw(10) << "spheres" << std::setw(8) << "width"
+		<< std::setw(8) << "bounds" << std::setw(10) << "nodes" << std::setw(10) << "MB" << std::setw(12) << "nodes/ray"
+		<< std::setw(12) << "boxes/ray" << std::setw(12) << "prims/ray" << std::setw(12) << "Mrays/s" << std::setw(8) << "missed" << "\n";
+
+	for (const WideResult& result : results) {
+		std::cout << std::setw(10) << result.primitivesCount << std::setw(8) << result.width << std::setw(8)
+			<< (result.quantized ? "8 bit" : "float") << std::setw(10) << result.nodesCount << std::fixed << std::setprecision(2)
+			<< std::setw(10) << result.nodesBytes / double(1 << 20) << std::setw(12) << result.nodesPerRay << std::setw(12)
+			<< result.boxTestsPerRay << std::setw(12) << result.primitiveTestsPerRay << std::setw(12) << result.raysPerSecond / 1e6
+			<< std::setw(8) << result.missedHits << (result.missedHits > 0 ? " FAIL" : "") << "\n";
+	}
+	std::cout.unsetf(std::ios::floatfield);
+}
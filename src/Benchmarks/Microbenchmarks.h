@@ -0,0 +1,135 @@
+#pragma once
+#include "../Raytracing/Scene.h"
+#include "../Backends/Adaptive.h"
+#include <string>
+#include <vector>
+
+//Host timings of the intersection and scattering hot paths. Rays and random numbers come from fixed
+//seeds, so runs on different commits measure exactly the same work
+namespace Microbenchmarks
+{
+	struct Result {
+		std::string name;
+		const char* unit; //What one op is, e.g. rays or samples
+		uint64_t opsCount;
+		double seconds; //Best of all repetitions
+		double drawsPerOp = 0.0; //Random numbers used per op, sampling benchmarks only
+		uint64_t mismatches = 0; //SphereSimd rows: rays whose closest sphere or distance differs from HittableList::hit, must be 0
+
+		inline double nsPerOp() const { return opsCount > 0 ? seconds * 1e9 / opsCount : 0.0; }
+		inline double opsPerSecond() const { return seconds > 0.0 ? opsCount / seconds : 0.0; }
+	};
+
+	//Two host wavefront renders of the same image, with Russian roulette and without
+	struct RouletteComparison {
+		int rouletteDepth;
+		glm::dvec3 meanWithout, meanWith; //Mean pixel radiance
+		glm::dvec3 standardError; //Of the mean per pixel difference, the check passes within 4 of them
+		double segmentsWithout, segmentsWith; //Average path length
+		double secondsWithout, secondsWith;
+		uint64_t raysWithout, raysWith;
+
+		bool unbiased() const;
+	};
+
+	//High sample image the convergence comparisons measure their error against
+	struct Reference {
+		uint32_t samplesPerPixel;
+		std::vector<glm::vec3> radiance;
+	};
+
+	//Uniform and adaptive renders with the same average samples per pixel, errors against a reference
+	struct AdaptiveResult {
+		uint32_t samplesPerPixel;
+		double adaptiveSamplesPerPixel; //Actually taken, below the budget when every pixel converged early
+		double uniformSeconds, adaptiveSeconds;
+		double uniformError, adaptiveError; //Relative MSE
+	};
+
+	struct AdaptiveComparison {
+		Adaptive::Settings settings;
+		uint32_t referenceSamples;
+		std::vector<AdaptiveResult> results;
+	};
+
+	//Uniform renders with independent and Sobol samples, errors against a reference
+	struct SamplerResult {
+		uint32_t samplesPerPixel;
+		double independentSeconds, sobolSeconds;
+		double independentError, sobolError; //RMSE of linear radiance
+	};
+
+	struct SamplerComparison {
+		uint32_t referenceSamples;
+		std::vector<SamplerResult> results;
+	};
+
+	//One tree over random spheres: build time (best of several) and closest hit throughput of random rays inside them
+	struct BuilderResult {
+		uint32_t primitivesCount;
+		std::string builder;
+		double buildSeconds;
+		double raysPerSecond; //One thread
+		float sahCost;
+		int depth;
+	};
+
+	//Random spheres in a box moving along straight lines and bouncing off its walls, every frame moves
+	//them a tenth of a radius. Refitting alone against full rebuilds and Scene::updateBVH
+	struct RefitComparison {
+		uint32_t spheresCount;
+		uint32_t framesCount;
+		float maxCostRatio;
+		double sahSeconds, lbvhSeconds; //One full rebuild
+		double refitSeconds; //Average refitBVH
+		std::vector<float> costRatios; //After every frame of refitting alone
+		double updateSeconds; //Average updateBVH, refits and the rebuilds it decided on
+		uint32_t rebuilds;
+		double refitRaysPerSecond, rebuiltRaysPerSecond; //After the last frame, refitted all along vs rebuilt for it
+	};
+
+	//SAH tree over random spheres, binary and collapsed to 4 and 8 children per node, float and 8 bit child bounds.
+	//Work per ray and closest hit throughput of random rays inside the spheres, one thread
+	struct WideResult {
+		uint32_t primitivesCount;
+		int width; //2 - the binary tree
+		bool quantized;
+		size_t nodesCount;
+		size_t nodesBytes;
+		double nodesPerRay, boxTestsPerRay, primitiveTestsPerRay;
+		double raysPerSecond;
+		uint64_t missedHits; //Rays whose closest hit differs from the binary tree's, must be 0
+	};
+
+	//Camera rays are traced through cam, diffuse rays bounce off the first hit of a camera ray
+	std::vector<Result> run(const Scene& scene, const Camera& cam, uint32_t raysCount, uint32_t seed = 1984);
+	void print(const std::vector<Result>& results);
+
+	//cam.getRouletteDepth() must be > 0, threadsCount 0 - one thread per core
+	RouletteComparison compareRoulette(const Scene& scene, const Camera& cam, uint32_t threadsCount = 0);
+	void print(const RouletteComparison& comparison);
+
+	//Independent samples, from indices no test render uses so its own noise isn't correlated with theirs
+	Reference renderReference(const Scene& scene, const Camera& cam, uint32_t samplesPerPixel, uint32_t threadsCount = 0);
+
+	//Host megakernel renders of cam at 4, 8, ... up to cam samples per pixel, reference of the same image size
+	AdaptiveComparison compareAdaptive(const Scene& scene, const Camera& cam, const Adaptive::Settings& settings, const Reference& reference,
+		uint32_t threadsCount = 0);
+	void print(const AdaptiveComparison& comparison);
+
+	//SAH and linear BVH (30 and 63 bit Morton codes) over sizes[i] spheres, builds on threadsCount threads
+	std::vector<BuilderResult> compareBuilders(const std::vector<uint32_t>& sizes, uint32_t raysCount, uint32_t threadsCount = 0, uint32_t seed = 1984);
+	void print(const std::vector<BuilderResult>& results);
+
+	//SAH builds, refits and updates on threadsCount threads
+	RefitComparison compareRefit(uint32_t spheresCount, uint32_t framesCount, uint32_t raysCount, uint32_t threadsCount = 0,
+		float maxCostRatio = 1.5f, uint32_t seed = 1984);
+	void print(const RefitComparison& comparison);
+
+	std::vector<WideResult> compareWidths(const std::vector<uint32_t>& sizes, uint32_t raysCount, uint32_t seed = 1984);
+	void print(const std::vector<WideResult>& results);
+
+	//Host megakernel renders of cam at 1, 2, 4, ... up to cam samples per pixel
+	SamplerComparison compareSamplers(const Scene& scene, const Camera& cam, const Reference& reference, uint32_t threadsCount = 0);
+	void print(const SamplerComparison& comparison);
+}
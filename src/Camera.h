@@ -1,6 +1,5 @@
 #pragma once
 #include "Raytracing/HittableList.h"
-#include <curand_kernel.h>
 #include "Raytracing/Materials/Material.h"
 
 struct dataPixels {
@@ -10,7 +9,7 @@ struct dataPixels {
 	unsigned char a;
 };
 
-__device__ inline double linearToGamma(double linearComponent) {
+__host__ __device__ inline double linearToGamma(double linearComponent) {
 	if (linearComponent > 0)
 		return sqrt(linearComponent);
 
@@ -20,7 +19,7 @@ __device__ inline double linearToGamma(double linearComponent) {
 class Camera
 {
 public:
-	__device__ Camera(glm::vec3 _lookFrom, glm::vec3 _lookAt, glm::vec3 _vUp, float vFOV, float _focusDist, float _defocusAngle
+	__host__ __device__ Camera(glm::vec3 _lookFrom, glm::vec3 _lookAt, glm::vec3 _vUp, float vFOV, float _focusDist, float _defocusAngle
 		, float aspectRat, int imgWidth, int samplesPerPx = 10, int maxDepth = 10)
 		: focusDistance(_focusDist), defocusAngle(_defocusAngle), verticalFov(vFOV), perPixelSamples(samplesPerPx),
 		aspectRatio(aspectRat), lookFrom(_lookFrom), lookAt(_lookAt), vUp(_vUp), center(lookFrom), maxRecursionDepth(maxDepth)
@@ -28,7 +27,7 @@ public:
 		pixelSampleScale = 1.0f / perPixelSamples;
 
 		imageSize.x = imgWidth;
-		imageSize.y = imageSize.x / aspectRatio;
+		imageSize.y = imageSize.x / aspectRatio + 0.5f; //Rounded, 1920 / (16 / 9) must stay 1080
 		imageSize.y = (imageSize.y < 1) ? 1 : imageSize.y;
 
 		float alpha = Utils::degToRad(verticalFov);
@@ -57,37 +56,87 @@ public:
 	}
 
 	__host__ __device__ inline glm::u32vec2 getImageSize() const { return imageSize; };
-	__device__ float getPixelSampleScale() { return pixelSampleScale; };
-	__device__ int getPerPixelSamples() { return perPixelSamples; };
-	__device__ int getMaxRecursionDepth() { return maxRecursionDepth; };
+	__host__ __device__ float getPixelSampleScale() const { return pixelSampleScale; };
+	__host__ __device__ int getPerPixelSamples() const { return perPixelSamples; };
+	__host__ __device__ int getMaxRecursionDepth() const { return maxRecursionDepth; };
+	__host__ __device__ int getRouletteDepth() const { return rouletteDepth; };
+	__host__ __device__ Utils::Sampler getSampler() const { return sampler; };
 
-	__device__ glm::vec3 rayColor(const Ray& ray, int depth, Hittable** world, curandState* localRandState) const
+	__host__ __device__ void setSampler(Utils::Sampler _sampler) { sampler = _sampler; };
+
+	//Russian roulette starts after this many bounces, 0 - off
+	__host__ __device__ void setRouletteDepth(int depth) { rouletteDepth = depth < 0 ? 0 : depth; };
+
+	//Called after bounce (0 based) with the updated throughput. Survivors are divided by the survival
+	//probability so the estimate stays unbiased, false - the path ends here
+	__host__ __device__ bool russianRoulette(int bounce, glm::vec3& throughput, Utils::RandState* localRandState) const
+	{
+		if (rouletteDepth == 0 || bounce + 1 < rouletteDepth)
+			return true;
+
+		float p = fminf(fmaxf(throughput.r, fmaxf(throughput.g, throughput.b)), 1.0f);
+		if (Utils::generateRandomNumber(localRandState) > p)
+			return false;
+
+		throughput /= p;
+		return true;
+	}
+
+	__device__ glm::vec3 rayColor(const Ray& ray, int depth, Hittable** world, Utils::RandState* localRandState) const
+	{
+		return rayColor(ray, depth, world, VirtualMaterials(), localRandState);
+	}
+
+	//Sum of samplesCount samples of pixel (i, j) starting at sample firstSample. Samples are keyed
+	//by index, so adding them over several calls gives the same result as one call.
+	//luminanceSquares (optional) gets the squared luminance of every sample added, for variance estimates
+	template<typename MaterialDispatch>
+	__host__ __device__ glm::vec3 samplePixel(uint32_t i, uint32_t j, uint32_t firstSample, uint32_t samplesCount, Hittable** world, const MaterialDispatch& materials,
+		float* luminanceSquares = nullptr) const
+	{
+		uint32_t pixelIndex = i + j * imageSize.x;
+		glm::vec3 pixelColor(0.0f, 0.0f, 0.0f);
+		float squares = 0.0f;
+		for (uint32_t sampleIdx = firstSample; sampleIdx < firstSample + samplesCount; sampleIdx++) {
+			Utils::RandState localRandState = Utils::makeRandState(pixelIndex, sampleIdx, 0, sampler);
+			Ray r = getRay(i, j, &localRandState);
+			glm::vec3 color = rayColor(r, maxRecursionDepth, world, materials, &localRandState);
+			float lum = Utils::luminance(color);
+			squares += lum * lum;
+			pixelColor += color;
+		}
+
+		if (luminanceSquares)
+			*luminanceSquares += squares;
+		return pixelColor;
+	}
+
+	//MaterialDispatch - VirtualMaterials or MaterialTable
+	template<typename MaterialDispatch>
+	__host__ __device__ glm::vec3 rayColor(const Ray& ray, int depth, Hittable** world, const MaterialDispatch& materials, Utils::RandState* localRandState) const
 	{
 		Ray cur_ray = ray;
 		glm::vec3 cur_attenuation(1.0f, 1.0f, 1.0f);
 
 		for (int i = 0; i < maxRecursionDepth; i++)
 		{
+			//Bounce 0 is used by getRay
+			Utils::setBounce(i + 1, localRandState);
 			hitData rec;
 			if ((*world)->hit(cur_ray, Interval(0.001f, Utils::infinity), rec))
 			{
 				Ray scattered(glm::vec3(0.0f), glm::vec3(0.0f));
 				glm::vec3 attenuation;
-				if (rec.mat->scatter(cur_ray, rec, attenuation, scattered, localRandState))
-				{
-					cur_attenuation *= attenuation;
-					cur_ray = scattered;
-				}
-				else
+				if (!materials.scatter(cur_ray, rec, attenuation, scattered, localRandState))
 					return glm::vec3(0.0, 0.0, 0.0);
-			}
-			else {
-				glm::vec3 unitDir = glm::normalize(cur_ray.direction());
 
-				float a = 0.5f * (unitDir.y + 1.0f);
-				glm::vec3 c = (1.0f - a) * glm::vec3(1.0f, 1.0f, 1.0f) + a * glm::vec3(0.5f, 0.7f, 1.0f);
-				return cur_attenuation * c;
+				cur_attenuation *= attenuation;
+				cur_ray = scattered;
+				if (!russianRoulette(i, cur_attenuation, localRandState))
+					return glm::vec3(0.0, 0.0, 0.0);
 			}
+			else
+				return cur_attenuation * background(cur_ray.direction());
 		}
 
 		return glm::vec3(0.0f, 0.0f, 0.0f); // exceeded recursion
@@ -114,7 +163,16 @@ public:
 	}
 
 
-	__device__ Ray getRay(int i, int j, curandState* localRandState) const
+	//Sky gradient between white and (0.5f, 0.7f, 1.0f) seen by rays that escape the scene
+	__host__ __device__ static glm::vec3 background(const glm::vec3& direction)
+	{
+		glm::vec3 unitDir = glm::normalize(direction);
+
+		float a = 0.5f * (unitDir.y + 1.0f);
+		return (1.0f - a) * glm::vec3(1.0f, 1.0f, 1.0f) + a * glm::vec3(0.5f, 0.7f, 1.0f);
+	}
+
+	__host__ __device__ Ray getRay(int i, int j, Utils::RandState* localRandState) const
 	{
 		glm::vec3 offset = sampleSquare(localRandState);
 		glm::vec3 pixelCenter = pixel00_loc + (((float)i + offset.x) * pixelDelta_u)
@@ -126,7 +184,7 @@ public:
 		return Ray(rayOrigin, rayDir);
 	}
 
-	__device__ dataPixels convertColor(const glm::vec3& color) {
+	__host__ __device__ dataPixels convertColor(const glm::vec3& color) const {
 		const Interval intensity(0.000, 0.999);
 
 		glm::vec3 newColor = glm::vec3(linearToGamma(color.r), linearToGamma(color.g), linearToGamma(color.b));
@@ -140,11 +198,11 @@ public:
 	}
 private:
 	//Camera helper functions
-	__device__ glm::vec3 sampleSquare(curandState* localRandState) const {
+	__host__ __device__ glm::vec3 sampleSquare(Utils::RandState* localRandState) const {
 		return glm::vec3(Utils::generateRandomNumber(-0.5, 0.5, localRandState),
 			Utils::generateRandomNumber(-0.5, 0.5, localRandState), 0);
 	}
-	__device__ glm::vec3 sampleDefocusDisk(curandState* localRandState) const {
+	__host__ __device__ glm::vec3 sampleDefocusDisk(Utils::RandState* localRandState) const {
 		glm::vec2 p = Utils::Vector::randomInUnitDisk(localRandState);
 		return center + (p.x * defocusDisk_u) + (p.y * defocusDisk_v);
 	}
@@ -168,6 +226,8 @@ private:
 	float aspectRatio = 1.0f;
 	int perPixelSamples = 10;
 	int maxRecursionDepth = 10;
+	int rouletteDepth = 0;
+	Utils::Sampler sampler = Utils::Sampler::Independent;
 	
 	glm::u32vec2 imageSize = glm::u32vec2(100, 1);
 	glm::vec3 center;
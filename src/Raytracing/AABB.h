@@ -0,0 +1,47 @@
+#pragma once
+#include "Ray.h"
+
+class AABB {
+public:
+	glm::vec3 _min, _max;
+
+	//Default box is empty, so growing it with anything gives that thing bounds
+	__host__ __device__ AABB() : _min(Utils::infinity), _max(-Utils::infinity) { }
+	__host__ __device__ AABB(const glm::vec3& min, const glm::vec3& max) : _min(min), _max(max) { }
+
+	__host__ __device__ void grow(const glm::vec3& point) {
+		_min = glm::min(_min, point);
+		_max = glm::max(_max, point);
+	}
+
+	__host__ __device__ void grow(const AABB& box) {
+		_min = glm::min(_min, box._min);
+		_max = glm::max(_max, box._max);
+	}
+
+	__host__ __device__ glm::vec3 centroid() const {
+		return 0.5f * (_min + _max);
+	}
+
+	__host__ __device__ float surfaceArea() const {
+		glm::vec3 e = _max - _min;
+		if (e.x < 0 || e.y < 0 || e.z < 0)
+			return 0.0f;
+		return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	//Slab test, invDir = 1 / ray.direction() precomputed by the caller
+	//Returns entry distance or infinity when the box is missed
+	__host__ __device__ float hit(const Ray& r, const glm::vec3& invDir, Interval rayT) const {
+		glm::vec3 t0 = (_min - r.origin()) * invDir;
+		glm::vec3 t1 = (_max - r.origin()) * invDir;
+
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+
+		float tEnter = fmaxf(fmaxf(tNear.x, tNear.y), fmaxf(tNear.z, rayT._min));
+		float tExit = fminf(fminf(tFar.x, tFar.y), fminf(tFar.z, rayT._max));
+
+		return tEnter <= tExit ? tEnter : Utils::infinity;
+	}
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include "../Hittable.h"
+
+//32 bytes, two nodes per cache line
+//Interior node: primCount == 0, children are nodes[leftFirst] and nodes[leftFirst + 1]
+//Leaf: primitives [leftFirst, leftFirst + primCount) of the reordered object array
+struct BVHNode {
+	AABB bounds;
+	uint32_t leftFirst;
+	uint32_t primCount;
+
+	__host__ __device__ bool isLeaf() const { return primCount > 0; }
+};
+
+namespace BVHLimits {
+	//Short stack, tree depth is bounded by the builder so this never overflows
+	constexpr int stackSize = 64;
+}
+
+//Work one closest hit query did, for comparing tree layouts (findClosest<true>)
+struct TraversalStats {
+	uint64_t nodes = 0; //Interior nodes whose children were tested
+	uint64_t boxTests = 0; //Child bounds tested, a wide node counts all of its slots
+	uint64_t primitiveTests = 0;
+};
+
+//Primitives is a view over primitive storage with size(), hitDistance(idx, ..., part), hitRecord(idx, part, ...) and boundingBox(idx),
+//e.g. SphereSet, TriangleSet or ScenePrimitives. Primitives must be in the order given by BVHBuilder::getPrimitiveIndices()
+template<typename Primitives>
+class BVH : public Hittable {
+public:
+	static constexpr int stackSize = BVHLimits::stackSize;
+
+	//nodes and primitive storage are not owned
+	__host__ __device__ BVH(const BVHNode* nodes, int nodesCount, const Primitives& primitives)
+		: nodes(nodes), nodesCount(nodesCount), primitives(primitives) { }
+
+	__host__ __device__ bool hit(const Ray& r, Interval rayT, hitData& data) const {
+		float closestHit;
+		uint32_t closestPrim, closestPart;
+		if (!findClosest(r, rayT, closestHit, closestPrim, closestPart))
+			return false;
+
+		primitives.hitRecord(closestPrim, closestPart, r, rayT, closestHit, data);
+		return true;
+	}
+
+	__host__ __device__ bool hitDistance(const Ray& r, Interval rayT, float& t) const {
+		uint32_t closestPrim, closestPart;
+		return findClosest(r, rayT, t, closestPrim, closestPart);
+	}
+
+	__host__ __device__ AABB boundingBox() const {
+		return nodes[0].bounds;
+	}
+
+	__host__ __device__ const Primitives& getPrimitives() const { return primitives; }
+
+	//Traversal only keeps t, the primitive index and the part of it that was hit (a compound primitive like an
+	//instance names its triangle, others ignore it), primitives.hitRecord() fills the record for the winner afterwards.
+	//CountSteps adds the work done to stats, otherwise stats isn't touched and the counting compiles away
+	template<bool CountSteps = false>
+	__host__ __device__ bool findClosest(const Ray& r, Interval rayT, float& closestHit, uint32_t& closestPrim, uint32_t& closestPart,
+		TraversalStats* stats = nullptr) const {
+		if (primitives.size() == 0)
+			return false;
+
+		glm::vec3 invDir = 1.0f / r.direction();
+		if (nodes[0].bounds.hit(r, invDir, rayT) == Utils::infinity)
+			return false;
+
+		bool hitAnything = false;
+		float t;
+		uint32_t part = 0;
+
+		uint32_t stack[stackSize];
+		int stackPtr = 0;
+		uint32_t nodeIdx = 0;
+
+		while (true) {
+			const BVHNode& node = nodes[nodeIdx];
+			if (node.isLeaf()) {
+				if (CountSteps)
+					stats->primitiveTests += node.primCount;
+				for (uint32_t i = 0; i < node.primCount; i++) {
+					if (primitives.hitDistance(node.leftFirst + i, r, rayT, t, part)) {
+						hitAnything = true;
+						rayT._max = t;
+						closestPrim = node.leftFirst + i;
+						closestPart = part;
+					}
+				}
+
+				if (stackPtr == 0)
+					break;
+				nodeIdx = stack[--stackPtr];
+				continue;
+			}
+
+			if (CountSteps) {
+				stats->nodes++;
+				stats->boxTests += 2;
+			}
+
+			//Visit nearer child first, far one goes on the stack
+			uint32_t nearIdx = node.leftFirst, farIdx = node.leftFirst + 1;
+			float tNear = nodes[nearIdx].bounds.hit(r, invDir, rayT);
+			float tFar = nodes[farIdx].bounds.hit(r, invDir, rayT);
+			if (tFar < tNear) {
+				float t = tNear; tNear = tFar; tFar = t;
+				uint32_t idx = nearIdx; nearIdx = farIdx; farIdx = idx;
+			}
+
+			if (tNear == Utils::infinity) {
+				if (stackPtr == 0)
+					break;
+				nodeIdx = stack[--stackPtr];
+				continue;
+			}
+
+			nodeIdx = nearIdx;
+			if (tFar != Utils::infinity)
+				stack[stackPtr++] = farIdx;
+		}
+
+		closestHit = rayT._max;
+		return hitAnything;
+	}
+
+private:
+	const BVHNode* nodes;
+	int nodesCount;
+	Primitives primitives;
+};
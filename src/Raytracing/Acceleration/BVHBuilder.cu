@@ -0,0 +1,230 @@
+#include "pch.h"
+#include "BVHBuilder.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+	constexpr int maxBins = 64;
+
+	struct Bin {
+		AABB bounds;
+		uint32_t count = 0;
+	};
+}
+
+BVHBuilder::BVHBuilder(int binsCount, int maxLeafSize)
+	: binsCount(std::clamp(binsCount, 2, maxBins)), maxLeafSize(std::max(maxLeafSize, 1))
+{
+}
+
+void BVHBuilder::build(const std::vector<AABB>& primitiveBounds, const std::vector<uint32_t>& rangeEnds)
+{
+	bounds = &primitiveBounds;
+	uint32_t primCount = static_cast<uint32_t>(primitiveBounds.size());
+
+	centroids.resize(primCount);
+	for (uint32_t i = 0; i < primCount; i++)
+		centroids[i] = primitiveBounds[i].centroid();
+
+	primIndices.resize(primCount);
+	std::iota(primIndices.begin(), primIndices.end(), 0);
+
+	//Binary tree with N leaves at most has 2N - 1 nodes
+	nodes.assign(std::max(2 * primCount, 2u) - 1, BVHNode());
+	nodesUsed = 1;
+	depth = 1;
+
+	//[first, end) of every non-empty range
+	std::vector<glm::u32vec2> ranges;
+	uint32_t rangeStart = 0;
+	for (uint32_t end : rangeEnds) {
+		end = std::min(end, primCount);
+		if (end > rangeStart)
+			ranges.push_back(glm::u32vec2(rangeStart, end));
+		rangeStart = std::max(rangeStart, end);
+	}
+	if (primCount > rangeStart || ranges.empty())
+		ranges.push_back(glm::u32vec2(rangeStart, primCount));
+
+	BVHNode& root = nodes[0];
+	root.leftFirst = 0;
+	root.primCount = primCount;
+	updateNodeBounds(0);
+	splitRanges(0, ranges, 0, ranges.size() - 1, 1);
+
+	nodes.resize(nodesUsed);
+	nodes.shrink_to_fit();
+	centroids.clear();
+	bounds = nullptr;
+}
+
+float BVHBuilder::sahCost(const std::vector<BVHNode>& nodes, float traversalCost, float intersectionCost)
+{
+	if (nodes.empty())
+		return 0.0f;
+
+	float rootArea = nodes[0].bounds.surfaceArea();
+	if (rootArea <= 0.0f)
+		return intersectionCost * nodes[0].primCount;
+
+	//Walked from the root, a depth limited LBVH leaves subtrees behind that no ray reaches
+	float cost = 0.0f;
+	std::vector<uint32_t> stack(1, 0u);
+	while (!stack.empty()) {
+		const BVHNode& node = nodes[stack.back()];
+		stack.pop_back();
+		float area = node.bounds.surfaceArea() / rootArea;
+		if (node.isLeaf()) {
+			cost += intersectionCost * node.primCount * area;
+			continue;
+		}
+		cost += traversalCost * area;
+		stack.push_back(node.leftFirst);
+		stack.push_back(node.leftFirst + 1);
+	}
+	return cost;
+}
+
+void BVHBuilder::updateNodeBounds(uint32_t nodeIdx)
+{
+	BVHNode& node = nodes[nodeIdx];
+	node.bounds = AABB();
+	for (uint32_t i = 0; i < node.primCount; i++)
+		node.bounds.grow((*bounds)[primIndices[node.leftFirst + i]]);
+}
+
+void BVHBuilder::splitRanges(uint32_t nodeIdx, const std::vector<glm::u32vec2>& ranges, size_t first, size_t last, int nodeDepth)
+{
+	if (first == last) {
+		subdivide(nodeIdx, nodeDepth);
+		return;
+	}
+
+	depth = std::max(depth, nodeDepth);
+	size_t mid = (first + last) / 2;
+
+	uint32_t leftIdx = nodesUsed;
+	nodesUsed += 2;
+
+	nodes[leftIdx].leftFirst = ranges[first].x;
+	nodes[leftIdx].primCount = ranges[mid].y - ranges[first].x;
+	nodes[leftIdx + 1].leftFirst = ranges[mid + 1].x;
+	nodes[leftIdx + 1].primCount = ranges[last].y - ranges[mid + 1].x;
+
+	BVHNode& node = nodes[nodeIdx];
+	node.leftFirst = leftIdx;
+	node.primCount = 0;
+
+	updateNodeBounds(leftIdx);
+	updateNodeBounds(leftIdx + 1);
+	splitRanges(leftIdx, ranges, first, mid, nodeDepth + 1);
+	splitRanges(leftIdx + 1, ranges, mid + 1, last, nodeDepth + 1);
+}
+
+void BVHBuilder::subdivide(uint32_t nodeIdx, int nodeDepth)
+{
+	depth = std::max(depth, nodeDepth);
+
+	BVHNode& node = nodes[nodeIdx];
+	if (node.primCount <= 1 || nodeDepth >= BVHLimits::stackSize)
+		return;
+
+	int axis = -1;
+	float splitPos = 0.0f;
+	float splitCost = findBestSplit(node, axis, splitPos);
+	float leafCost = node.primCount * node.bounds.surfaceArea();
+
+	//Splitting does not pay off, big leaves get split anyway to keep leaf tests short
+	if (splitCost >= leafCost && node.primCount <= static_cast<uint32_t>(maxLeafSize))
+		return;
+
+	uint32_t first = node.leftFirst;
+	uint32_t last = first + node.primCount;
+	uint32_t mid = first;
+
+	if (axis >= 0) {
+		auto it = std::partition(primIndices.begin() + first, primIndices.begin() + last,
+			[&](uint32_t prim) { return centroids[prim][axis] < splitPos; });
+		mid = static_cast<uint32_t>(it - primIndices.begin());
+	}
+
+	//All centroids in one bin (coincident primitives), fall back to splitting by count
+	if (mid == first || mid == last) {
+		if (node.primCount <= static_cast<uint32_t>(maxLeafSize))
+			return;
+		mid = first + node.primCount / 2;
+	}
+
+	uint32_t leftIdx = nodesUsed;
+	nodesUsed += 2;
+
+	nodes[leftIdx].leftFirst = first;
+	nodes[leftIdx].primCount = mid - first;
+	nodes[leftIdx + 1].leftFirst = mid;
+	nodes[leftIdx + 1].primCount = last - mid;
+
+	node.leftFirst = leftIdx;
+	node.primCount = 0;
+
+	updateNodeBounds(leftIdx);
+	updateNodeBounds(leftIdx + 1);
+	subdivide(leftIdx, nodeDepth + 1);
+	subdivide(leftIdx + 1, nodeDepth + 1);
+}
+
+float BVHBuilder::findBestSplit(const BVHNode& node, int& axis, float& splitPos) const
+{
+	float bestCost = Utils::infinity;
+
+	AABB centroidBounds;
+	for (uint32_t i = 0; i < node.primCount; i++)
+		centroidBounds.grow(centroids[primIndices[node.leftFirst + i]]);
+
+	for (int a = 0; a < 3; a++) {
+		float boundsMin = centroidBounds._min[a];
+		float boundsMax = centroidBounds._max[a];
+		if (boundsMin == boundsMax)
+			continue;
+
+		Bin bins[maxBins];
+		float scale = binsCount / (boundsMax - boundsMin);
+		for (uint32_t i = 0; i < node.primCount; i++) {
+			uint32_t prim = primIndices[node.leftFirst + i];
+			int binIdx = std::min(binsCount - 1, static_cast<int>((centroids[prim][a] - boundsMin) * scale));
+			bins[binIdx].count++;
+			bins[binIdx].bounds.grow((*bounds)[prim]);
+		}
+
+		//Sweep from both sides, plane i lies between bin i and bin i + 1
+		float leftArea[maxBins - 1], rightArea[maxBins - 1];
+		uint32_t leftCount[maxBins - 1], rightCount[maxBins - 1];
+		AABB leftBox, rightBox;
+		uint32_t leftSum = 0, rightSum = 0;
+		for (int i = 0; i < binsCount - 1; i++) {
+			leftSum += bins[i].count;
+			leftCount[i] = leftSum;
+			leftBox.grow(bins[i].bounds);
+			leftArea[i] = leftBox.surfaceArea();
+
+			rightSum += bins[binsCount - 1 - i].count;
+			rightCount[binsCount - 2 - i] = rightSum;
+			rightBox.grow(bins[binsCount - 1 - i].bounds);
+			rightArea[binsCount - 2 - i] = rightBox.surfaceArea();
+		}
+
+		for (int i = 0; i < binsCount - 1; i++) {
+			if (leftCount[i] == 0 || rightCount[i] == 0)
+				continue;
+
+			float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+			if (cost < bestCost) {
+				bestCost = cost;
+				axis = a;
+				splitPos = boundsMin + (i + 1) / scale;
+			}
+		}
+	}
+
+	return bestCost;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "BVH.h"
+#include <vector>
+
+//Host side binned SAH builder, output can be uploaded as is and wrapped in BVH
+class BVHBuilder
+{
+public:
+	BVHBuilder(int binsCount = 16, int maxLeafSize = 4);
+
+	//rangeEnds - ascending ends of consecutive primitive ranges, the last one may be left out. Every non-empty range gets
+	//a subtree of its own whatever SAH says, so primitive kinds stored one after another keep their index ranges after reordering
+	void build(const std::vector<AABB>& primitiveBounds, const std::vector<uint32_t>& rangeEnds = std::vector<uint32_t>());
+
+	inline const std::vector<BVHNode>& getNodes() const { return nodes; }
+	//Object i of the BVH is primitive primIndices[i] of the input
+	inline const std::vector<uint32_t>& getPrimitiveIndices() const { return primIndices; }
+	inline int getDepth() const { return depth; }
+
+	//SAH cost of the nodes reachable from the root, relative to the root area
+	float sahCost(float traversalCost = 1.0f, float intersectionCost = 1.0f) const { return sahCost(nodes, traversalCost, intersectionCost); }
+	//Same for any tree in this layout, e.g. from LBVHBuilder
+	static float sahCost(const std::vector<BVHNode>& nodes, float traversalCost = 1.0f, float intersectionCost = 1.0f);
+
+private:
+	void updateNodeBounds(uint32_t nodeIdx);
+	void subdivide(uint32_t nodeIdx, int nodeDepth);
+	//Node over ranges [first, last] gets one child per half of them until a single range is left for subdivide
+	void splitRanges(uint32_t nodeIdx, const std::vector<glm::u32vec2>& ranges, size_t first, size_t last, int nodeDepth);
+	float findBestSplit(const BVHNode& node, int& axis, float& splitPos) const;
+
+	int binsCount;
+	int maxLeafSize;
+	int depth = 0;
+
+	const std::vector<AABB>* bounds = nullptr;
+	std::vector<glm::vec3> centroids;
+	std::vector<BVHNode> nodes;
+	std::vector<uint32_t> primIndices;
+	uint32_t nodesUsed = 0;
+};
@@ -0,0 +1,50 @@
+#include "pch.h"
+#include "BVHRefitter.h"
+
+BVHRefitter::BVHRefitter(uint32_t threadsCount)
+	: pool(threadsCount)
+{
+}
+
+void BVHRefitter::linkTree(const std::vector<BVHNode>& nodes, std::vector<uint32_t>& parents, std::vector<uint32_t>& leaves)
+{
+	parents.assign(nodes.size(), 0);
+	leaves.clear();
+	if (nodes.empty())
+		return;
+
+	//Only what the root reaches, a builder may leave unused nodes behind
+	std::vector<uint32_t> stack(1, 0);
+	while (!stack.empty()) {
+		uint32_t nodeIdx = stack.back();
+		stack.pop_back();
+
+		const BVHNode& node = nodes[nodeIdx];
+		if (node.isLeaf()) {
+			leaves.push_back(nodeIdx);
+			continue;
+		}
+		if (nodes.size() == 1)
+			break; //Empty tree, the root has no children
+
+		for (uint32_t child = node.leftFirst; child < node.leftFirst + 2; child++) {
+			parents[child] = nodeIdx;
+			stack.push_back(child);
+		}
+	}
+}
+
+void BVHRefitter::refit(std::vector<BVHNode>& nodes, const std::vector<uint32_t>& parents, const std::vector<uint32_t>& leaves,
+	const std::vector<AABB>& primitiveBounds)
+{
+	if (arrivalsSize < nodes.size()) {
+		arrivals.reset(new std::atomic<uint32_t>[nodes.size()]);
+		arrivalsSize = nodes.size();
+	}
+
+	pool.parallelForEach(static_cast<uint32_t>(nodes.size()), [&](uint32_t idx) { arrivals[idx].store(0, std::memory_order_relaxed); });
+	pool.parallelForEach(static_cast<uint32_t>(leaves.size()), [&](uint32_t idx) {
+		Refit::refitFromLeaf(leaves[idx], nodes.data(), parents.data(), primitiveBounds.data(),
+			[&](uint32_t node) { return arrivals[node].fetch_add(1, std::memory_order_acq_rel); });
+	});
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "Refit.h"
+#include "../../Utils/ThreadPool.h"
+#include <vector>
+
+//Host side refit (see Refit.h), much cheaper than a rebuild while primitives only move a little. Splits chosen for the
+//old positions get worse as things move, the SAH cost against the fresh tree tells when a rebuild is due (Scene::updateBVH)
+class BVHRefitter
+{
+public:
+	//threadsCount 0 - one thread per core
+	explicit BVHRefitter(uint32_t threadsCount = 0);
+
+	//Parent of every node reachable from the root and the reachable leaves, once per build
+	static void linkTree(const std::vector<BVHNode>& nodes, std::vector<uint32_t>& parents, std::vector<uint32_t>& leaves);
+
+	//primitiveBounds in leaf order, parents and leaves from linkTree
+	void refit(std::vector<BVHNode>& nodes, const std::vector<uint32_t>& parents, const std::vector<uint32_t>& leaves,
+		const std::vector<AABB>& primitiveBounds);
+
+private:
+	ThreadPool pool;
+	std::unique_ptr<std::atomic<uint32_t>[]> arrivals;
+	size_t arrivalsSize = 0;
+};
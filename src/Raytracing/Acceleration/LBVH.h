@@ -0,0 +1,160 @@
+#pragma once
+#include "BVH.h"
+#include "Refit.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//Linear BVH stages (Karras - Maximizing Parallelism in the Construction of BVHs, Octrees, and k-d Trees).
+//Every function handles one element and only touches what that element owns, so LBVHBuilder runs them
+//over host threads and a kernel can call them once per thread the same way.
+//
+//Hierarchy layout: n sorted leaves and n - 1 internal nodes, internal node 0 is the root.
+//Child references have leafFlag set for leaves. Output BVHNode slots: 0 is the root,
+//the two children of internal node i go to slots 2i + 1 and 2i + 2, so they stay adjacent as BVH wants
+namespace LBVH
+{
+	constexpr uint32_t leafFlag = 0x80000000u;
+
+	enum class MortonBits { Bits30, Bits63 };
+
+	__host__ __device__ inline int countLeadingZeros(uint64_t x) {
+#ifdef __CUDA_ARCH__
+		return __clzll(static_cast<long long>(x));
+#elif defined(_MSC_VER)
+		unsigned long index;
+		return _BitScanReverse64(&index, x) ? 63 - static_cast<int>(index) : 64;
+#else
+		return x == 0 ? 64 : __builtin_clzll(x);
+#endif
+	}
+
+	//Spreads the low 10 bits of x so there are two zero bits after every one
+	__host__ __device__ inline uint32_t expandBits10(uint32_t x) {
+		x &= 0x3ffu;
+		x = (x | (x << 16)) & 0x030000ffu;
+		x = (x | (x << 8)) & 0x0300f00fu;
+		x = (x | (x << 4)) & 0x030c30c3u;
+		x = (x | (x << 2)) & 0x09249249u;
+		return x;
+	}
+
+	//Same for the low 21 bits
+	__host__ __device__ inline uint64_t expandBits21(uint64_t x) {
+		x &= 0x1fffffull;
+		x = (x | (x << 32)) & 0x001f00000000ffffull;
+		x = (x | (x << 16)) & 0x001f0000ff0000ffull;
+		x = (x | (x << 8)) & 0x100f00f00f00f00full;
+		x = (x | (x << 4)) & 0x10c30c30c30c30c3ull;
+		x = (x | (x << 2)) & 0x1249249249249249ull;
+		return x;
+	}
+
+	//unit - centroid scaled to [0, 1] over the centroid bounds of the whole build
+	__host__ __device__ inline uint64_t mortonCode(glm::vec3 unit, MortonBits bits) {
+		if (bits == MortonBits::Bits30) {
+			glm::vec3 q = glm::clamp(unit * 1024.0f, glm::vec3(0.0f), glm::vec3(1023.0f));
+			return (expandBits10(uint32_t(q.x)) << 2) | (expandBits10(uint32_t(q.y)) << 1) | expandBits10(uint32_t(q.z));
+		}
+
+		glm::vec3 q = glm::clamp(unit * 2097152.0f, glm::vec3(0.0f), glm::vec3(2097151.0f));
+		return (expandBits21(uint64_t(q.x)) << 2) | (expandBits21(uint64_t(q.y)) << 1) | expandBits21(uint64_t(q.z));
+	}
+
+	//Length of the common prefix of sorted leaves i and j, -1 outside [0, n). Keys compare as if they were
+	//(range id, Morton code, leaf index), so ranges split first and duplicate codes still give a strict order.
+	//rangeIds == nullptr - one range
+	__host__ __device__ inline int delta(const uint64_t* keys, const uint32_t* rangeIds, int n, int i, int j) {
+		if (j < 0 || j >= n)
+			return -1;
+		if (rangeIds && rangeIds[i] != rangeIds[j])
+			return countLeadingZeros(rangeIds[i] ^ rangeIds[j]) - 32;
+		if (keys[i] != keys[j])
+			return 32 + countLeadingZeros(keys[i] ^ keys[j]);
+		return 96 + countLeadingZeros(static_cast<uint32_t>(i ^ j)) - 32;
+	}
+
+	//Children of internal node i (0 <= i < n - 1), first and last leaf under it and parents of both children.
+	//parents has n - 1 internal entries followed by n leaf entries
+	__host__ __device__ inline void emitInternalNode(const uint64_t* keys, const uint32_t* rangeIds, int n, int i,
+		uint32_t* leftChildren, uint32_t* rightChildren, glm::u32vec2* leafRanges, uint32_t* parents) {
+		//Direction of the range: towards the neighbour sharing the longer prefix
+		int d = delta(keys, rangeIds, n, i, i + 1) - delta(keys, rangeIds, n, i, i - 1) >= 0 ? 1 : -1;
+		int deltaMin = delta(keys, rangeIds, n, i, i - d);
+
+		//Other end: exponential search for an upper bound, then binary search
+		int lengthMax = 2;
+		while (delta(keys, rangeIds, n, i, i + lengthMax * d) > deltaMin)
+			lengthMax *= 2;
+		int length = 0;
+		for (int t = lengthMax / 2; t >= 1; t /= 2) {
+			if (delta(keys, rangeIds, n, i, i + (length + t) * d) > deltaMin)
+				length += t;
+		}
+		int j = i + length * d;
+
+		//Split: last leaf sharing more than deltaNode bits with i
+		int deltaNode = delta(keys, rangeIds, n, i, j);
+		int split = 0;
+		for (int divisor = 2, t = length; t > 1; divisor *= 2) {
+			t = (length + divisor - 1) / divisor;
+			if (delta(keys, rangeIds, n, i, i + (split + t) * d) > deltaNode)
+				split += t;
+		}
+		int gamma = i + split * d + (d < 0 ? -1 : 0);
+
+		int first = d > 0 ? i : j, last = d > 0 ? j : i;
+		uint32_t left = first == gamma ? uint32_t(gamma) | leafFlag : uint32_t(gamma);
+		uint32_t right = last == gamma + 1 ? uint32_t(gamma + 1) | leafFlag : uint32_t(gamma + 1);
+
+		leftChildren[i] = left;
+		rightChildren[i] = right;
+		leafRanges[i] = glm::u32vec2(first, last);
+		parents[left & leafFlag ? (n - 1) + (left & ~leafFlag) : left] = i;
+		parents[right & leafFlag ? (n - 1) + (right & ~leafFlag) : right] = i;
+	}
+
+	//Leaf climbs towards the root with Refit::climbToRoot, the second child to reach a node fills it in.
+	//Heights are counted in nodes, leaves are 1
+	template<typename Arrive>
+	__host__ __device__ inline void propagateBounds(int leaf, int n, const AABB* leafBounds, const uint32_t* leftChildren,
+		const uint32_t* rightChildren, const uint32_t* parents, AABB* internalBounds, uint32_t* heights, Arrive arrive) {
+		Refit::climbToRoot(parents[(n - 1) + leaf], parents, arrive, [&](uint32_t node) {
+			uint32_t children[2] = { leftChildren[node], rightChildren[node] };
+			AABB box;
+			uint32_t height = 0;
+			for (uint32_t child : children) {
+				if (child & leafFlag) {
+					box.grow(leafBounds[child & ~leafFlag]);
+					height = height > 1 ? height : 1;
+				}
+				else {
+					box.grow(internalBounds[child]);
+					height = height > heights[child] ? height : heights[child];
+				}
+			}
+			internalBounds[node] = box;
+			heights[node] = height + 1;
+		});
+	}
+
+	//Children of internal node i into slots 2i + 1 and 2i + 2
+	__host__ __device__ inline void writeChildren(int i, const AABB* leafBounds, const uint32_t* leftChildren, const uint32_t* rightChildren,
+		const AABB* internalBounds, BVHNode* nodes) {
+		uint32_t children[2] = { leftChildren[i], rightChildren[i] };
+		for (int c = 0; c < 2; c++) {
+			BVHNode& node = nodes[2 * i + 1 + c];
+			uint32_t child = children[c];
+			if (child & leafFlag) {
+				node.bounds = leafBounds[child & ~leafFlag];
+				node.leftFirst = child & ~leafFlag;
+				node.primCount = 1;
+			}
+			else {
+				node.bounds = internalBounds[child];
+				node.leftFirst = 2 * child + 1;
+				node.primCount = 0;
+			}
+		}
+	}
+}
@@ -0,0 +1,205 @@
+#include "pch.h"
+#include "LBVHBuilder.h"
+#include "../../Utils/Timer.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+	constexpr uint32_t radixBits = 8;
+	constexpr uint32_t radixSize = 1 << radixBits;
+}
+
+LBVHBuilder::LBVHBuilder(uint32_t threadsCount, LBVH::MortonBits mortonBits)
+	: pool(threadsCount), mortonBits(mortonBits)
+{
+}
+
+void LBVHBuilder::build(const std::vector<AABB>& primitiveBounds, const std::vector<uint32_t>& rangeEnds)
+{
+	timings = Timings();
+	uint32_t primCount = static_cast<uint32_t>(primitiveBounds.size());
+	primIndices.resize(primCount);
+	std::iota(primIndices.begin(), primIndices.end(), 0);
+
+	depth = 1;
+	if (primCount <= 1) {
+		nodes.assign(1, BVHNode());
+		nodes[0].leftFirst = 0;
+		nodes[0].primCount = primCount;
+		if (primCount == 1)
+			nodes[0].bounds = primitiveBounds[0];
+		return;
+	}
+
+	//Morton codes over the centroid bounds
+	auto start = std::chrono::steady_clock::now();
+	std::vector<AABB> chunkBounds(ThreadPool::chunksCount(primCount));
+	pool.parallelForChunks(primCount, [&](uint32_t chunk, uint32_t first, uint32_t last) {
+		for (uint32_t idx = first; idx < last; idx++)
+			chunkBounds[chunk].grow(primitiveBounds[idx].centroid());
+	});
+	AABB centroidBounds;
+	for (const AABB& box : chunkBounds)
+		centroidBounds.grow(box);
+
+	glm::vec3 extent = centroidBounds._max - centroidBounds._min;
+	glm::vec3 scale(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+	keys.resize(primCount);
+	pool.parallelForEach(primCount, [&](uint32_t idx) {
+		keys[idx] = LBVH::mortonCode((primitiveBounds[idx].centroid() - centroidBounds._min) * scale, mortonBits);
+	});
+
+	//Ranges are contiguous in the input already, sorting each on its own keeps them that way
+	std::vector<glm::u32vec2> ranges;
+	uint32_t rangeStart = 0;
+	for (uint32_t end : rangeEnds) {
+		end = std::min(end, primCount);
+		if (end > rangeStart)
+			ranges.push_back(glm::u32vec2(rangeStart, end));
+		rangeStart = std::max(rangeStart, end);
+	}
+	if (primCount > rangeStart)
+		ranges.push_back(glm::u32vec2(rangeStart, primCount));
+
+	rangeIds.clear();
+	if (ranges.size() > 1) {
+		rangeIds.resize(primCount);
+		for (uint32_t r = 0; r < ranges.size(); r++)
+			std::fill(rangeIds.begin() + ranges[r].x, rangeIds.begin() + ranges[r].y, r);
+	}
+	timings.morton = Utils::secondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	keysScratch.resize(primCount);
+	indicesScratch.resize(primCount);
+	for (const glm::u32vec2& range : ranges)
+		sortRange(range.x, range.y);
+	timings.sort = Utils::secondsSince(start);
+
+	//Karras hierarchy, one pass over internal nodes
+	start = std::chrono::steady_clock::now();
+	int n = static_cast<int>(primCount);
+	const uint32_t* rangeIdsData = rangeIds.empty() ? nullptr : rangeIds.data();
+	leftChildren.resize(n - 1);
+	rightChildren.resize(n - 1);
+	leafRanges.resize(n - 1);
+	parents.resize(2 * n - 1);
+	pool.parallelForEach(n - 1, [&](uint32_t i) {
+		LBVH::emitInternalNode(keys.data(), rangeIdsData, n, int(i), leftChildren.data(), rightChildren.data(), leafRanges.data(), parents.data());
+	});
+	timings.hierarchy = Utils::secondsSince(start);
+
+	//Bottom-up bounds, leaves climb in parallel
+	start = std::chrono::steady_clock::now();
+	leafBounds.resize(n);
+	internalBounds.resize(n - 1);
+	heights.resize(n - 1);
+	if (arrivalsSize < size_t(n - 1)) {
+		arrivals.reset(new std::atomic<uint32_t>[n - 1]);
+		arrivalsSize = n - 1;
+	}
+	pool.parallelForEach(n - 1, [&](uint32_t i) { arrivals[i].store(0, std::memory_order_relaxed); });
+	pool.parallelForEach(primCount, [&](uint32_t leaf) {
+		leafBounds[leaf] = primitiveBounds[primIndices[leaf]];
+		LBVH::propagateBounds(int(leaf), n, leafBounds.data(), leftChildren.data(), rightChildren.data(), parents.data(), internalBounds.data(),
+			heights.data(), [&](uint32_t node) { return arrivals[node].fetch_add(1, std::memory_order_acq_rel); });
+	});
+	timings.bounds = Utils::secondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	nodes.resize(2 * size_t(n) - 1);
+	nodes[0].bounds = internalBounds[0];
+	nodes[0].leftFirst = 1;
+	nodes[0].primCount = 0;
+	pool.parallelForEach(n - 1, [&](uint32_t i) {
+		LBVH::writeChildren(int(i), leafBounds.data(), leftChildren.data(), rightChildren.data(), internalBounds.data(), nodes.data());
+	});
+
+	depth = static_cast<int>(heights[0]);
+	if (depth > BVHLimits::stackSize)
+		limitDepth();
+	timings.emit = Utils::secondsSince(start);
+}
+
+void LBVHBuilder::sortRange(uint32_t first, uint32_t last)
+{
+	uint32_t count = last - first;
+	uint32_t chunks = ThreadPool::chunksCount(count);
+	chunkHistograms.resize(size_t(chunks) * radixSize);
+
+	uint64_t* srcKeys = keys.data() + first;
+	uint64_t* dstKeys = keysScratch.data() + first;
+	uint32_t* srcIndices = primIndices.data() + first;
+	uint32_t* dstIndices = indicesScratch.data() + first;
+
+	int keyBits = mortonBits == LBVH::MortonBits::Bits30 ? 30 : 63;
+	for (int shift = 0; shift < keyBits; shift += radixBits) {
+		pool.parallelForChunks(count, [&](uint32_t chunk, uint32_t begin, uint32_t end) {
+			uint32_t* histogram = chunkHistograms.data() + size_t(chunk) * radixSize;
+			std::fill(histogram, histogram + radixSize, 0u);
+			for (uint32_t idx = begin; idx < end; idx++)
+				histogram[(srcKeys[idx] >> shift) & (radixSize - 1)]++;
+		});
+
+		//Digit major, chunk minor offsets keep the sort stable. A digit every key shares needs no pass
+		bool allSame = false;
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < radixSize; digit++) {
+			uint32_t digitStart = offset;
+			for (uint32_t chunk = 0; chunk < chunks; chunk++) {
+				uint32_t& entry = chunkHistograms[size_t(chunk) * radixSize + digit];
+				uint32_t entryCount = entry;
+				entry = offset;
+				offset += entryCount;
+			}
+			allSame |= offset - digitStart == count;
+		}
+		if (allSame)
+			continue;
+
+		pool.parallelForChunks(count, [&](uint32_t chunk, uint32_t begin, uint32_t end) {
+			uint32_t* offsets = chunkHistograms.data() + size_t(chunk) * radixSize;
+			for (uint32_t idx = begin; idx < end; idx++) {
+				uint32_t dst = offsets[(srcKeys[idx] >> shift) & (radixSize - 1)]++;
+				dstKeys[dst] = srcKeys[idx];
+				dstIndices[dst] = srcIndices[idx];
+			}
+		});
+		std::swap(srcKeys, dstKeys);
+		std::swap(srcIndices, dstIndices);
+	}
+
+	if (srcKeys != keys.data() + first) {
+		pool.parallelForEach(count, [&](uint32_t idx) {
+			keys[first + idx] = srcKeys[idx];
+			primIndices[first + idx] = srcIndices[idx];
+		});
+	}
+}
+
+void LBVHBuilder::limitDepth()
+{
+	//Interior node in slot s > 0 came from internal node (leftFirst - 1) / 2, the leaves under it are contiguous
+	std::vector<glm::u32vec2> stack;
+	stack.push_back(glm::u32vec2(0, 1));
+	while (!stack.empty()) {
+		glm::u32vec2 entry = stack.back();
+		stack.pop_back();
+
+		BVHNode& node = nodes[entry.x];
+		if (node.isLeaf())
+			continue;
+
+		if (entry.y >= static_cast<uint32_t>(BVHLimits::stackSize)) {
+			glm::u32vec2 range = leafRanges[(node.leftFirst - 1) / 2];
+			node.leftFirst = range.x;
+			node.primCount = range.y - range.x + 1;
+			continue;
+		}
+
+		stack.push_back(glm::u32vec2(node.leftFirst, entry.y + 1));
+		stack.push_back(glm::u32vec2(node.leftFirst + 1, entry.y + 1));
+	}
+	depth = BVHLimits::stackSize;
+}
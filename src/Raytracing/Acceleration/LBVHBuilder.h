@@ -0,0 +1,57 @@
+#pragma once
+#include "LBVH.h"
+#include "../../Utils/ThreadPool.h"
+#include <vector>
+
+//Host side linear BVH builder: Morton codes, parallel radix sort and Karras hierarchy emission, every stage
+//one parallel pass (see LBVH.h). Much faster to build than BVHBuilder's SAH sweep, for per-frame rebuilds,
+//but traces slower since splits follow the Morton grid instead of the geometry. Output works like BVHBuilder's
+class LBVHBuilder
+{
+public:
+	//threadsCount 0 - one thread per core
+	LBVHBuilder(uint32_t threadsCount = 0, LBVH::MortonBits mortonBits = LBVH::MortonBits::Bits30);
+
+	//rangeEnds as in BVHBuilder::build, every non-empty range gets a subtree of its own
+	void build(const std::vector<AABB>& primitiveBounds, const std::vector<uint32_t>& rangeEnds = std::vector<uint32_t>());
+
+	inline const std::vector<BVHNode>& getNodes() const { return nodes; }
+	//Object i of the BVH is primitive primIndices[i] of the input
+	inline const std::vector<uint32_t>& getPrimitiveIndices() const { return primIndices; }
+	inline int getDepth() const { return depth; }
+
+	//Seconds spent in each stage by the last build
+	struct Timings {
+		double morton = 0.0;
+		double sort = 0.0;
+		double hierarchy = 0.0;
+		double bounds = 0.0;
+		double emit = 0.0;
+	};
+	inline const Timings& getTimings() const { return timings; }
+
+private:
+	//Stable LSD radix sort of keys[first, last) with primIndices alongside, 8 bits per pass
+	void sortRange(uint32_t first, uint32_t last);
+	//Leaves under the depth the traversal stack allows become multi-primitive leaves
+	void limitDepth();
+
+	ThreadPool pool;
+	LBVH::MortonBits mortonBits;
+	int depth = 0;
+	Timings timings;
+
+	std::vector<BVHNode> nodes;
+	std::vector<uint32_t> primIndices;
+
+	//Scratch, kept between builds so per-frame rebuilds don't allocate
+	std::vector<uint64_t> keys, keysScratch;
+	std::vector<uint32_t> indicesScratch;
+	std::vector<uint32_t> rangeIds;
+	std::vector<uint32_t> chunkHistograms; //256 entries per chunk
+	std::vector<AABB> leafBounds, internalBounds;
+	std::vector<uint32_t> leftChildren, rightChildren, parents, heights;
+	std::vector<glm::u32vec2> leafRanges;
+	std::unique_ptr<std::atomic<uint32_t>[]> arrivals;
+	size_t arrivalsSize = 0;
+};
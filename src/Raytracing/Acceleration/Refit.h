@@ -0,0 +1,40 @@
+#pragma once
+#include "BVH.h"
+
+//Bottom-up bounds update of a built tree whose primitives moved, topology stays as it is. Like LBVH.h, one
+//function per element that BVHRefitter runs over host threads and a kernel could run one thread per leaf
+namespace Refit
+{
+	//Climb from a leaf's parent node towards root 0. At every node the first child to arrive stops, the second one
+	//finds both children done, merge(node) fills the node in from them and it goes on. arrive(node) returns how many
+	//arrived before (an atomic add), on a GPU the bounds write has to be fenced before it
+	template<typename Arrive, typename Merge>
+	__host__ __device__ inline void climbToRoot(uint32_t node, const uint32_t* parents, Arrive arrive, Merge merge) {
+		while (arrive(node) == 1) {
+			merge(node);
+			if (node == 0)
+				break;
+			node = parents[node];
+		}
+	}
+
+	//Leaf node leafIdx takes the bounds of its primitives and climbs towards the root, see climbToRoot
+	template<typename Arrive>
+	__host__ __device__ inline void refitFromLeaf(uint32_t leafIdx, BVHNode* nodes, const uint32_t* parents, const AABB* primitiveBounds,
+		Arrive arrive) {
+		BVHNode& leaf = nodes[leafIdx];
+		AABB box;
+		for (uint32_t i = 0; i < leaf.primCount; i++)
+			box.grow(primitiveBounds[leaf.leftFirst + i]);
+		leaf.bounds = box;
+
+		if (leafIdx == 0)
+			return; //Single leaf tree
+
+		climbToRoot(parents[leafIdx], parents, arrive, [&](uint32_t node) {
+			AABB merged = nodes[nodes[node].leftFirst].bounds;
+			merged.grow(nodes[nodes[node].leftFirst + 1].bounds);
+			nodes[node].bounds = merged;
+		});
+	}
+}
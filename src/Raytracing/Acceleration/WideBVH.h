@@ -0,0 +1,236 @@
+#pragma once
+#include "BVH.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if !defined(__CUDA_ARCH__) && (defined(_M_X64) || defined(__x86_64__))
+#define WIDE_BVH_SSE 1
+#include <immintrin.h>
+#endif
+
+//Child bounds of a wide node per axis (structure of arrays), so one slab test covers all of them: 4 children fill
+//an SSE register, 8 an AVX one (or two SSE tests without AVX enabled at compile time)
+template<int Width>
+struct WideBounds {
+	static_assert(Width == 4 || Width == 8, "Wide BVH nodes have 4 or 8 children");
+
+	float minX[Width], minY[Width], minZ[Width];
+	float maxX[Width], maxY[Width], maxZ[Width];
+};
+
+namespace WideSlab
+{
+	__host__ __device__ inline int lowestBit(uint32_t mask) {
+#ifdef __CUDA_ARCH__
+		return __ffs(mask) - 1;
+#elif defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	//Bit i set when child i is hit inside rayT, tEnter[i] is its entry distance. Same arithmetic as AABB::hit, which
+	//counts an entry at infinity as a miss too (an unbounded ray reaching the empty slot point)
+	template<int Width>
+	__host__ __device__ inline uint32_t hitMask(const WideBounds<Width>& bounds, const glm::vec3& origin, const glm::vec3& invDir,
+		Interval rayT, float* tEnter) {
+#if defined(WIDE_BVH_SSE) && defined(__AVX__)
+		if (Width == 8) {
+			__m256 ox = _mm256_set1_ps(origin.x), oy = _mm256_set1_ps(origin.y), oz = _mm256_set1_ps(origin.z);
+			__m256 ix = _mm256_set1_ps(invDir.x), iy = _mm256_set1_ps(invDir.y), iz = _mm256_set1_ps(invDir.z);
+			__m256 x0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds.minX), ox), ix);
+			__m256 x1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds.maxX), ox), ix);
+			__m256 y0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds.minY), oy), iy);
+			__m256 y1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds.maxY), oy), iy);
+			__m256 z0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds.minZ), oz), iz);
+			__m256 z1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bounds.maxZ), oz), iz);
+
+			__m256 enter = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(x0, x1), _mm256_min_ps(y0, y1)),
+				_mm256_max_ps(_mm256_min_ps(z0, z1), _mm256_set1_ps(rayT._min)));
+			__m256 tExit = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(x0, x1), _mm256_max_ps(y0, y1)),
+				_mm256_min_ps(_mm256_max_ps(z0, z1), _mm256_set1_ps(rayT._max)));
+			_mm256_storeu_ps(tEnter, enter);
+			__m256 hit = _mm256_and_ps(_mm256_cmp_ps(enter, tExit, _CMP_LE_OQ), _mm256_cmp_ps(enter, _mm256_set1_ps(Utils::infinity), _CMP_LT_OQ));
+			return static_cast<uint32_t>(_mm256_movemask_ps(hit));
+		}
+#endif
+#ifdef WIDE_BVH_SSE
+		__m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+		__m128 ix = _mm_set1_ps(invDir.x), iy = _mm_set1_ps(invDir.y), iz = _mm_set1_ps(invDir.z);
+		__m128 rayMin = _mm_set1_ps(rayT._min), rayMax = _mm_set1_ps(rayT._max), infinity = _mm_set1_ps(Utils::infinity);
+		uint32_t mask = 0;
+		for (int i = 0; i < Width; i += 4) {
+			__m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds.minX + i), ox), ix);
+			__m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds.maxX + i), ox), ix);
+			__m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds.minY + i), oy), iy);
+			__m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds.maxY + i), oy), iy);
+			__m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds.minZ + i), oz), iz);
+			__m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds.maxZ + i), oz), iz);
+
+			__m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), rayMin));
+			__m128 tExit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), rayMax));
+			_mm_storeu_ps(tEnter + i, enter);
+			__m128 hit = _mm_and_ps(_mm_cmple_ps(enter, tExit), _mm_cmplt_ps(enter, infinity));
+			mask |= static_cast<uint32_t>(_mm_movemask_ps(hit)) << i;
+		}
+		return mask;
+#else
+		uint32_t mask = 0;
+		for (int i = 0; i < Width; i++) {
+			float x0 = (bounds.minX[i] - origin.x) * invDir.x, x1 = (bounds.maxX[i] - origin.x) * invDir.x;
+			float y0 = (bounds.minY[i] - origin.y) * invDir.y, y1 = (bounds.maxY[i] - origin.y) * invDir.y;
+			float z0 = (bounds.minZ[i] - origin.z) * invDir.z, z1 = (bounds.maxZ[i] - origin.z) * invDir.z;
+			tEnter[i] = fmaxf(fmaxf(fminf(x0, x1), fminf(y0, y1)), fmaxf(fminf(z0, z1), rayT._min));
+			float tExit = fminf(fminf(fmaxf(x0, x1), fmaxf(y0, y1)), fminf(fmaxf(z0, z1), rayT._max));
+			mask |= (tEnter[i] <= tExit && tEnter[i] < Utils::infinity ? 1u : 0u) << i;
+		}
+		return mask;
+#endif
+	}
+}
+
+//Built by WideBVHBuilder::collapse from a binary tree, primitives keep the binary tree's order.
+//Width 4 is 128 bytes, 8 is 256, both whole cache lines
+template<int Width>
+struct WideBVHNode : WideBounds<Width> {
+	//children of unused slots, their bounds are a point at +infinity, only ever entered at t = infinity, which is a miss
+	static constexpr uint32_t emptySlot = 0xffffffffu;
+	//Levels below the binary tree's depth limit, leaves are the binary tree's own
+	static constexpr int extraLevels = 0;
+
+	//counts[i] == 0 - interior child, node index in children[i]
+	//counts[i] > 0 - leaf, primitives [children[i], children[i] + counts[i])
+	uint32_t children[Width];
+	uint32_t counts[Width];
+
+	__host__ __device__ bool used(int slot) const { return children[slot] != emptySlot || counts[slot] > 0; }
+
+	__host__ __device__ AABB childBounds(int slot) const {
+		return AABB(glm::vec3(this->minX[slot], this->minY[slot], this->minZ[slot]), glm::vec3(this->maxX[slot], this->maxY[slot], this->maxZ[slot]));
+	}
+
+	__host__ __device__ uint32_t slabTest(const glm::vec3& origin, const glm::vec3& invDir, Interval rayT, float* tEnter) const {
+		return WideSlab::hitMask<Width>(*this, origin, invDir, rayT, tEnter);
+	}
+};
+
+//Closest hit over a wide tree, same contract as BVH. Children that are hit are visited near to far, and entries
+//whose box starts behind the closest hit found meanwhile are dropped when they come off the stack.
+//Node - WideBVHNode or anything with the same children, counts, extraLevels, used, childBounds and slabTest (QuantizedBVHNode)
+template<typename Primitives, int Width, typename Node = WideBVHNode<Width>>
+class WideBVH : public Hittable {
+public:
+	//Every level leaves at most Width - 1 entries behind and the tree is no deeper than the binary one it came from,
+	//plus the levels Node adds under its leaves
+	static constexpr int stackSize = (BVHLimits::stackSize + Node::extraLevels) * (Width - 1) + 1;
+
+	//nodes and primitive storage are not owned
+	__host__ __device__ WideBVH(const Node* nodes, int nodesCount, const Primitives& primitives)
+		: nodes(nodes), nodesCount(nodesCount), primitives(primitives) { }
+
+	__host__ __device__ bool hit(const Ray& r, Interval rayT, hitData& data) const {
+		float closestHit;
+		uint32_t closestPrim, closestPart;
+		if (!findClosest(r, rayT, closestHit, closestPrim, closestPart))
+			return false;
+
+		primitives.hitRecord(closestPrim, closestPart, r, rayT, closestHit, data);
+		return true;
+	}
+
+	__host__ __device__ bool hitDistance(const Ray& r, Interval rayT, float& t) const {
+		uint32_t closestPrim, closestPart;
+		return findClosest(r, rayT, t, closestPrim, closestPart);
+	}
+
+	__host__ __device__ AABB boundingBox() const {
+		AABB box;
+		for (int i = 0; i < Width; i++) {
+			if (nodes[0].used(i))
+				box.grow(nodes[0].childBounds(i));
+		}
+		return box;
+	}
+
+	__host__ __device__ const Primitives& getPrimitives() const { return primitives; }
+
+	template<bool CountSteps = false>
+	__host__ __device__ bool findClosest(const Ray& r, Interval rayT, float& closestHit, uint32_t& closestPrim, uint32_t& closestPart,
+		TraversalStats* stats = nullptr) const {
+		if (primitives.size() == 0 || nodesCount == 0)
+			return false;
+
+		glm::vec3 invDir = 1.0f / r.direction();
+		bool hitAnything = false;
+		float t;
+		uint32_t part = 0;
+
+		StackEntry stack[stackSize];
+		int stackPtr = 0;
+		StackEntry entry = { 0, 0, rayT._min };
+
+		while (true) {
+			if (entry.count > 0) {
+				if (CountSteps)
+					stats->primitiveTests += entry.count;
+				for (uint32_t i = entry.child; i < entry.child + entry.count; i++) {
+					if (primitives.hitDistance(i, r, rayT, t, part)) {
+						hitAnything = true;
+						rayT._max = t;
+						closestPrim = i;
+						closestPart = part;
+					}
+				}
+			}
+			else {
+				const Node& node = nodes[entry.child];
+				if (CountSteps) {
+					stats->nodes++;
+					stats->boxTests += Width;
+				}
+
+				float tEnter[Width];
+				uint32_t hitMask = node.slabTest(r.origin(), invDir, rayT, tEnter);
+
+				//Hit children sorted far to near, so the nearest one is on top of the stack
+				int first = stackPtr;
+				while (hitMask) {
+					int lane = WideSlab::lowestBit(hitMask);
+					hitMask &= hitMask - 1;
+
+					StackEntry child = { node.children[lane], node.counts[lane], tEnter[lane] };
+					int slot = stackPtr++;
+					while (slot > first && stack[slot - 1].tEnter < child.tEnter) {
+						stack[slot] = stack[slot - 1];
+						slot--;
+					}
+					stack[slot] = child;
+				}
+			}
+
+			//Anything starting past the closest hit so far can't give a closer one
+			do {
+				if (stackPtr == 0) {
+					closestHit = rayT._max;
+					return hitAnything;
+				}
+				entry = stack[--stackPtr];
+			} while (entry.tEnter > rayT._max);
+		}
+	}
+
+private:
+	struct StackEntry {
+		uint32_t child;
+		uint32_t count; //0 - interior node
+		float tEnter;
+	};
+
+	const Node* nodes;
+	int nodesCount;
+	Primitives primitives;
+};
@@ -0,0 +1,215 @@
+#include "pch.h"
+#include "WideBVHBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	template<int Width>
+	void setSlot(WideBVHNode<Width>& node, int slot, const AABB& bounds, uint32_t child, uint32_t count)
+	{
+		node.minX[slot] = bounds._min.x;
+		node.minY[slot] = bounds._min.y;
+		node.minZ[slot] = bounds._min.z;
+		node.maxX[slot] = bounds._max.x;
+		node.maxY[slot] = bounds._max.y;
+		node.maxZ[slot] = bounds._max.z;
+		node.children[slot] = child;
+		node.counts[slot] = count;
+	}
+
+	template<int Width>
+	WideBVHNode<Width> emptyNode()
+	{
+		WideBVHNode<Width> node;
+		AABB farPoint(glm::vec3(Utils::infinity), glm::vec3(Utils::infinity));
+		for (int slot = 0; slot < Width; slot++)
+			setSlot(node, slot, farPoint, WideBVHNode<Width>::emptySlot, 0);
+		return node;
+	}
+
+	//Child of a node about to be quantized, count 0 - interior
+	struct Slot {
+		AABB bounds;
+		uint32_t child;
+		uint32_t count;
+	};
+
+	template<int Width>
+	QuantizedBVHNode<Width> quantizeNode(const Slot* slots, int slotsCount)
+	{
+		using Node = QuantizedBVHNode<Width>;
+		Node node = Node();
+		if (slotsCount == 0)
+			return node;
+
+		AABB box;
+		for (int s = 0; s < slotsCount; s++)
+			box.grow(slots[s].bounds);
+
+		uint8_t* lo[3] = { node.loX, node.loY, node.loZ };
+		uint8_t* hi[3] = { node.hiX, node.hiY, node.hiZ };
+		for (int axis = 0; axis < 3; axis++) {
+			//Smallest step whose 255 steps reach the top of the box once decoded
+			float origin = box._min[axis];
+			float extent = box._max[axis] - origin;
+			int exponent = -126;
+			if (extent > 0.0f) {
+				std::frexp(extent / 255.0f, &exponent);
+				exponent = std::clamp(exponent, -126, 127);
+			}
+			while (exponent < 127 && Node::decode(origin, 255, Node::step(exponent)) < box._max[axis])
+				exponent++;
+
+			node.origin[axis] = origin;
+			node.exponents[axis] = static_cast<int8_t>(exponent);
+
+			//Rounded outwards, then moved further until the decoded plane is outside the float one
+			float step = Node::step(exponent);
+			for (int s = 0; s < slotsCount; s++) {
+				float min = slots[s].bounds._min[axis], max = slots[s].bounds._max[axis];
+				double qMin = std::floor((double(min) - double(origin)) / step);
+				double qMax = std::ceil((double(max) - double(origin)) / step);
+				int qLo = static_cast<int>(std::clamp(qMin, 0.0, 255.0));
+				int qHi = static_cast<int>(std::clamp(qMax, 0.0, 255.0));
+				while (qLo > 0 && Node::decode(origin, uint8_t(qLo), step) > min)
+					qLo--;
+				while (qHi < 255 && Node::decode(origin, uint8_t(qHi), step) < max)
+					qHi++;
+				lo[axis][s] = static_cast<uint8_t>(qLo);
+				hi[axis][s] = static_cast<uint8_t>(qHi);
+			}
+		}
+
+		for (int s = 0; s < slotsCount; s++) {
+			node.usedMask |= uint8_t(1u << s);
+			node.children[s] = slots[s].child;
+			node.counts[s] = static_cast<uint8_t>(slots[s].count);
+		}
+		return node;
+	}
+
+	//Primitives [first, first + count) spread over the slots of a new node, each slot with the whole leaf's bounds,
+	//and over nodes under it while they don't fit. false past levels nodes deep
+	template<int Width>
+	bool splitLeaf(std::vector<QuantizedBVHNode<Width>>& quantized, const AABB& bounds, uint32_t first, uint32_t count, int levels,
+		uint32_t& nodeIdx)
+	{
+		if (levels == 0)
+			return false;
+
+		nodeIdx = static_cast<uint32_t>(quantized.size());
+		quantized.emplace_back();
+
+		Slot slots[Width];
+		int slotsCount = 0;
+		uint32_t chunk = (count + Width - 1) / Width;
+		for (uint32_t start = 0; start < count; start += chunk) {
+			Slot& slot = slots[slotsCount++];
+			slot.bounds = bounds;
+			slot.count = std::min(chunk, count - start);
+			slot.child = first + start;
+			if (slot.count > QuantizedBVHNode<Width>::maxLeafSize) {
+				if (!splitLeaf<Width>(quantized, bounds, first + start, slot.count, levels - 1, slot.child))
+					return false;
+				slot.count = 0;
+			}
+		}
+
+		quantized[nodeIdx] = quantizeNode<Width>(slots, slotsCount);
+		return true;
+	}
+}
+
+template<int Width>
+std::vector<WideBVHNode<Width>> WideBVHBuilder::collapse(const std::vector<BVHNode>& nodes)
+{
+	std::vector<WideBVHNode<Width>> wide(1, emptyNode<Width>());
+	if (nodes.empty())
+		return wide;
+
+	const BVHNode& root = nodes[0];
+	if (root.isLeaf()) {
+		setSlot(wide[0], 0, root.bounds, root.leftFirst, root.primCount);
+		return wide;
+	}
+	if (nodes.size() == 1)
+		return wide; //Empty tree, the root has no children
+
+	//Wide node index and the binary interior node it stands for. Children of one node are allocated together
+	std::vector<glm::u32vec2> stack(1, glm::u32vec2(0, 0));
+	while (!stack.empty()) {
+		glm::u32vec2 entry = stack.back();
+		stack.pop_back();
+
+		uint32_t slots[Width];
+		int slotsCount = 0;
+		slots[slotsCount++] = nodes[entry.y].leftFirst;
+		slots[slotsCount++] = nodes[entry.y].leftFirst + 1;
+		while (slotsCount < Width) {
+			int largest = -1;
+			float largestArea = -1.0f;
+			for (int s = 0; s < slotsCount; s++) {
+				const BVHNode& node = nodes[slots[s]];
+				if (!node.isLeaf() && node.bounds.surfaceArea() > largestArea) {
+					largest = s;
+					largestArea = node.bounds.surfaceArea();
+				}
+			}
+			if (largest < 0)
+				break;
+
+			uint32_t opened = slots[largest];
+			slots[largest] = nodes[opened].leftFirst;
+			slots[slotsCount++] = nodes[opened].leftFirst + 1;
+		}
+
+		for (int s = 0; s < slotsCount; s++) {
+			const BVHNode& node = nodes[slots[s]];
+			if (node.isLeaf()) {
+				setSlot(wide[entry.x], s, node.bounds, node.leftFirst, node.primCount);
+				continue;
+			}
+
+			uint32_t child = static_cast<uint32_t>(wide.size());
+			wide.push_back(emptyNode<Width>());
+			setSlot(wide[entry.x], s, node.bounds, child, 0);
+			stack.push_back(glm::u32vec2(child, slots[s]));
+		}
+	}
+
+	return wide;
+}
+
+template<int Width>
+bool WideBVHBuilder::quantize(const std::vector<WideBVHNode<Width>>& nodes, std::vector<QuantizedBVHNode<Width>>& quantized)
+{
+	quantized.assign(nodes.size(), QuantizedBVHNode<Width>());
+	for (size_t i = 0; i < nodes.size(); i++) {
+		Slot slots[Width];
+		int slotsCount = 0;
+		for (int s = 0; s < Width; s++) {
+			if (!nodes[i].used(s))
+				continue;
+
+			Slot& slot = slots[slotsCount++];
+			slot.bounds = nodes[i].childBounds(s);
+			slot.child = nodes[i].children[s];
+			slot.count = nodes[i].counts[s];
+			if (slot.count > QuantizedBVHNode<Width>::maxLeafSize) {
+				if (!splitLeaf<Width>(quantized, slot.bounds, slot.child, slot.count, QuantizedBVHNode<Width>::extraLevels, slot.child)) {
+					quantized.clear();
+					return false;
+				}
+				slot.count = 0;
+			}
+		}
+		quantized[i] = quantizeNode<Width>(slots, slotsCount);
+	}
+	return true;
+}
+
+template std::vector<WideBVHNode<4>> WideBVHBuilder::collapse<4>(const std::vector<BVHNode>& nodes);
+template std::vector<WideBVHNode<8>> WideBVHBuilder::collapse<8>(const std::vector<BVHNode>& nodes);
+template bool WideBVHBuilder::quantize<4>(const std::vector<WideBVHNode<4>>& nodes, std::vector<QuantizedBVHNode<4>>& quantized);
+template bool WideBVHBuilder::quantize<8>(const std::vector<WideBVHNode<8>>& nodes, std::vector<QuantizedBVHNode<8>>& quantized);
@@ -0,0 +1,19 @@
+#pragma once
+#include "QuantizedBVH.h"
+#include <vector>
+
+//Collapses a binary tree (any of the builders) into a wide one. Every wide node takes the binary node's two children
+//and keeps opening the interior child with the largest surface area until Width slots are full or only leaves are left
+class WideBVHBuilder
+{
+public:
+	//Leaves and primitive order stay as they are, the wide tree traces the same primitive arrays
+	template<int Width>
+	static std::vector<WideBVHNode<Width>> collapse(const std::vector<BVHNode>& nodes);
+
+	//8 bit child bounds of every node, node indices stay the same. Leaves over QuantizedBVHNode::maxLeafSize get
+	//nodes of their own after the others. false when one needs more than QuantizedBVHNode::extraLevels of them,
+	//only a depth limited tree over huge numbers of coincident primitives gets there, keep the float nodes then
+	template<int Width>
+	static bool quantize(const std::vector<WideBVHNode<Width>>& nodes, std::vector<QuantizedBVHNode<Width>>& quantized);
+};
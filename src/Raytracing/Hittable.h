@@ -1,5 +1,6 @@
 #pragma once
 #include "Ray.h"
+#include "AABB.h"
 
 class Material;
 class hitData {
@@ -7,11 +8,12 @@ public:
 	glm::vec3 p;
 	glm::vec3 normal;
 	Material* mat;
+	uint32_t materialId; //Index into MaterialTable
 	float t;
 	bool frontFace;
 
 	//outwardNormal - unit length
-	__device__ void setFaceNormal(const Ray& ray, const glm::vec3& outwardNormal) {
+	__host__ __device__ void setFaceNormal(const Ray& ray, const glm::vec3& outwardNormal) {
 		frontFace = glm::dot(ray.direction(), outwardNormal) < 0;
 		normal = frontFace ? outwardNormal : -outwardNormal;
 	}
@@ -19,7 +21,23 @@ public:
 
 class Hittable {
 public:
-	__device__ virtual ~Hittable() = default;
+	__host__ __device__ virtual ~Hittable() = default;
 
-	__device__ virtual bool hit(const Ray& r, Interval rayT, hitData& data) const = 0;
+	__host__ __device__ virtual bool hit(const Ray& r, Interval rayT, hitData& data) const = 0;
+
+	//Closest-hit searches only track t with hitDistance and call hitRecord once for the final winner.
+	//rayT in hitRecord is the interval the search started with. Defaults fall back to a full hit()
+	__host__ __device__ virtual bool hitDistance(const Ray& r, Interval rayT, float& t) const {
+		hitData data;
+		if (!hit(r, rayT, data))
+			return false;
+		t = data.t;
+		return true;
+	}
+
+	__host__ __device__ virtual void hitRecord(const Ray& r, Interval rayT, float t, hitData& data) const {
+		hit(r, rayT, data);
+	}
+
+	__host__ __device__ virtual AABB boundingBox() const = 0;
 };
\ No newline at end of file
@@ -7,23 +7,46 @@ public:
 	Hittable** objects = nullptr;
 	int objectsSize = 1;
 
-	__device__ HittableList() {}
-	__device__ HittableList(Hittable** o, int size) { objects = o; objectsSize = size; }
-	__host__ ~HittableList() { delete []objects; }
+	__host__ __device__ HittableList() {}
+	__host__ __device__ HittableList(Hittable** o, int size) { objects = o; objectsSize = size; }
+	__host__ __device__ ~HittableList() { delete []objects; }
 
-	__device__ bool hit(const Ray& r, Interval rayT, hitData& data) const {
-		hitData tmp_data;
-		bool hitAnything = false;
-		double closestHit = rayT._max;
+	__host__ __device__ bool hit(const Ray& r, Interval rayT, hitData& data) const {
+		float closestHit;
+		int closestObject;
+		if (!closest(r, rayT, closestHit, closestObject))
+			return false;
 
+		objects[closestObject]->hitRecord(r, rayT, closestHit, data);
+		return true;
+	}
+
+	__host__ __device__ bool hitDistance(const Ray& r, Interval rayT, float& t) const {
+		int closestObject;
+		return closest(r, rayT, t, closestObject);
+	}
+
+	__host__ __device__ AABB boundingBox() const {
+		AABB box;
+		for (int i = 0; i < objectsSize; i++)
+			box.grow(objects[i]->boundingBox());
+		return box;
+	}
+
+private:
+	//Only t and the object index are tracked, the record is filled once for the winner
+	__host__ __device__ bool closest(const Ray& r, Interval rayT, float& closestHit, int& closestObject) const {
+		closestObject = -1;
+		closestHit = rayT._max;
+
+		float t;
 		for (int i = 0; i < objectsSize; i++) {
-			if (objects[i]->hit(r, Interval(rayT._min, closestHit), tmp_data)) {
-				hitAnything = true;
-				closestHit = tmp_data.t;
-				data = tmp_data;
+			if (objects[i]->hitDistance(r, Interval(rayT._min, closestHit), t)) {
+				closestHit = t;
+				closestObject = i;
 			}
 		}
 
-		return hitAnything;
+		return closestObject >= 0;
 	}
 };
\ No newline at end of file
@@ -9,7 +9,12 @@ namespace Materials
 	public:
 		__device__ Dielectric(float refractionIndex) : refractionIndex(refractionIndex) { }
 
-		__device__ bool scatter(const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, curandState* localRandState) const {
+		__device__ bool scatter(const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, Utils::RandState* localRandState) const {
+			return scatter(refractionIndex, rayIn, data, attenuation, rayScattered, localRandState);
+		}
+
+		//Shared by the virtual path and MaterialTable
+		__host__ __device__ static bool scatter(float refractionIndex, const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, Utils::RandState* localRandState) {
 			attenuation = glm::vec3(1.0, 1.0, 1.0);
 			float ri = data.frontFace ? (1.0 / refractionIndex) : refractionIndex;
 
@@ -32,7 +37,7 @@ namespace Materials
 	private:
 		float refractionIndex;
 
-		__device__ static float reflectance(float cos, float refractionIndex) {
+		__host__ __device__ static float reflectance(float cos, float refractionIndex) {
 			float r0 = (1 - refractionIndex) / (1 + refractionIndex);
 			r0 *= r0;
 			return r0 + (1 - r0) * pow((1 - cos), 5);
@@ -9,12 +9,14 @@ namespace Materials
 	public:
 		__device__ Lambertian(const glm::vec3& albedo) : albedo(albedo) { }
 
-		__device__ bool scatter(const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, curandState* localRandState) const {
-			glm::vec3 scatterDirection = data.normal + Utils::Vector::randomInUnitSphereVector(localRandState);
+		__device__ bool scatter(const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, Utils::RandState* localRandState) const {
+			return scatter(albedo, rayIn, data, attenuation, rayScattered, localRandState);
+		}
 
-			//Obsluga tego jak random vector bedzie odwrotnoscia normali, wtedy moga sie pojawic rozne bledy :(
-			if (Utils::Vector::nearZero(scatterDirection))
-				scatterDirection = data.normal;
+		//Shared by the virtual path and MaterialTable
+		__host__ __device__ static bool scatter(const glm::vec3& albedo, const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, Utils::RandState* localRandState) {
+			//Same cosine distribution as normal + random unit vector, but never degenerate
+			glm::vec3 scatterDirection = Utils::Vector::randomCosineHemisphere(data.normal, localRandState);
 
 			rayScattered = Ray(data.p, scatterDirection);
 			attenuation = albedo;
@@ -5,7 +5,15 @@ class Material
 public:
 	__device__ virtual ~Material() = default;
 
-	__device__ virtual bool scatter(const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, curandState* localRandState) const {
+	__device__ virtual bool scatter(const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, Utils::RandState* localRandState) const {
 		return false;
 	}
+};
+
+//Dispatches through Material::scatter vtable, kept to compare against MaterialTable
+struct VirtualMaterials
+{
+	__device__ bool scatter(const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, Utils::RandState* localRandState) const {
+		return data.mat->scatter(rayIn, data, attenuation, rayScattered, localRandState);
+	}
 };
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+#include "../../Utils/Utils.h"
+
+enum class MaterialType : uint32_t {
+	Lambertian = 0,
+	Metal,
+	Dielectric
+};
+
+//Plain material description, same layout on host and device so it can be uploaded with the scene
+struct MaterialData {
+	glm::vec3 albedo;
+	float param; //Metal - fuzz, Dielectric - refraction index
+	MaterialType type;
+
+	static MaterialData lambertian(const glm::vec3& albedo) {
+		return { albedo, 0.0f, MaterialType::Lambertian };
+	}
+
+	static MaterialData metal(const glm::vec3& albedo, float fuzz) {
+		return { albedo, fuzz < 1 ? fuzz : 1, MaterialType::Metal };
+	}
+
+	static MaterialData dielectric(float refractionIndex) {
+		return { glm::vec3(1.0f, 1.0f, 1.0f), refractionIndex, MaterialType::Dielectric };
+	}
+};
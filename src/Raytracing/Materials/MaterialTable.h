@@ -0,0 +1,28 @@
+#pragma once
+#include "MaterialData.h"
+#include "Lambertian.h"
+#include "Metal.h"
+#include "Dielectric.h"
+
+//All materials in one array, selected by hitData::materialId and dispatched with a switch
+//instead of a virtual call. Uses the same scatter code as the Material classes
+struct MaterialTable
+{
+	const MaterialData* materials = nullptr;
+	uint32_t count = 0;
+
+	__host__ __device__ bool scatter(const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, Utils::RandState* localRandState) const {
+		const MaterialData& material = materials[data.materialId];
+
+		switch (material.type) {
+		case MaterialType::Lambertian:
+			return Materials::Lambertian::scatter(material.albedo, rayIn, data, attenuation, rayScattered, localRandState);
+		case MaterialType::Metal:
+			return Materials::Metal::scatter(material.albedo, material.param, rayIn, data, attenuation, rayScattered, localRandState);
+		case MaterialType::Dielectric:
+			return Materials::Dielectric::scatter(material.param, rayIn, data, attenuation, rayScattered, localRandState);
+		}
+
+		return false;
+	}
+};
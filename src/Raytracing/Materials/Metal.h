@@ -9,7 +9,12 @@ namespace Materials
 	public:
 		__device__ Metal(const glm::dvec3& albedo, float fuzz) : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) { }
 
-		__device__ bool scatter(const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, curandState* localRandState) const {
+		__device__ bool scatter(const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, Utils::RandState* localRandState) const {
+			return scatter(albedo, fuzz, rayIn, data, attenuation, rayScattered, localRandState);
+		}
+
+		//Shared by the virtual path and MaterialTable
+		__host__ __device__ static bool scatter(const glm::vec3& albedo, float fuzz, const Ray& rayIn, const hitData& data, glm::vec3& attenuation, Ray& rayScattered, Utils::RandState* localRandState) {
 			glm::vec3 reflected = Utils::Vector::reflect(rayIn.direction(), data.normal);
 			reflected = glm::normalize(reflected) + (fuzz * Utils::Vector::randomInUnitSphereVector(localRandState));
 
@@ -0,0 +1,71 @@
+#pragma once
+#include "../Hittable.h"
+
+//Transformed copy of shared geometry, e.g. a BVH over a mesh. The ray goes to object space instead of the geometry
+//going to world space, so any number of instances cost one transform each and the geometry is stored once
+class Instance : public Hittable
+{
+public:
+	//object is not owned, mat == nullptr keeps the materials object reports
+	__host__ __device__ Instance(const Hittable* object, const glm::mat4& objectToWorld, Material* mat = nullptr, uint32_t materialId = 0)
+		: object(object), objectToWorld(objectToWorld), worldToObject(glm::inverse(objectToWorld)), mat(mat), materialId(materialId) {}
+
+	__host__ __device__ bool hit(const Ray& r, Interval rayT, hitData& data) const {
+		if (!object->hit(toObject(r, worldToObject), rayT, data))
+			return false;
+
+		finishRecord(r, data);
+		return true;
+	}
+
+	__host__ __device__ bool hitDistance(const Ray& r, Interval rayT, float& t) const {
+		return object->hitDistance(toObject(r, worldToObject), rayT, t);
+	}
+
+	__host__ __device__ void hitRecord(const Ray& r, Interval rayT, float t, hitData& data) const {
+		object->hitRecord(toObject(r, worldToObject), rayT, t, data);
+		finishRecord(r, data);
+	}
+
+	__host__ __device__ AABB boundingBox() const {
+		return transformBounds(object->boundingBox(), objectToWorld);
+	}
+
+	//Shared with InstanceSet. Direction is not renormalized, so t is the same in both spaces
+	__host__ __device__ static inline Ray toObject(const Ray& r, const glm::mat4& worldToObject) {
+		return Ray(glm::vec3(worldToObject * glm::vec4(r.origin(), 1.0f)), glm::vec3(worldToObject * glm::vec4(r.direction(), 0.0f)));
+	}
+
+	//data filled in object space for toObject(r), normals go through the inverse transpose.
+	//Sign of dot(direction, normal) survives the transform, so frontFace stays valid
+	__host__ __device__ static inline void toWorld(const Ray& r, const glm::mat4& worldToObject, hitData& data) {
+		data.p = r.at(data.t);
+		data.normal = glm::normalize(glm::transpose(glm::mat3(worldToObject)) * data.normal);
+	}
+
+	//Box around the transformed box: center moves, extent goes through |M| (Arvo)
+	__host__ __device__ static inline AABB transformBounds(const AABB& box, const glm::mat4& objectToWorld) {
+		glm::vec3 center = glm::vec3(objectToWorld * glm::vec4(box.centroid(), 1.0f));
+		glm::mat3 m(objectToWorld);
+		glm::vec3 extent = 0.5f * (box._max - box._min);
+		glm::vec3 worldExtent(0.0f);
+		for (int i = 0; i < 3; i++)
+			worldExtent += glm::abs(m[i]) * extent[i];
+		return AABB(center - worldExtent, center + worldExtent);
+	}
+
+private:
+	__host__ __device__ void finishRecord(const Ray& r, hitData& data) const {
+		toWorld(r, worldToObject, data);
+		if (mat) {
+			data.mat = mat;
+			data.materialId = materialId;
+		}
+	}
+
+	const Hittable* object;
+	glm::mat4 objectToWorld;
+	glm::mat4 worldToObject;
+	Material* mat;
+	uint32_t materialId;
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include "Instance.h"
+#include "TriangleSet.h"
+#include "../Acceleration/BVH.h"
+
+//Bottom level structure of one unique mesh, a range of the scene's shared geometry nodes and triangles.
+//Node children and leaf primitives are relative to the range start
+struct MeshGeometry {
+	uint32_t firstNode;
+	uint32_t nodesCount;
+	uint32_t firstTriangle;
+	uint32_t trianglesCount;
+};
+
+struct InstanceData {
+	glm::mat4 objectToWorld;
+	glm::mat4 worldToObject;
+	uint32_t geometryId;
+	uint32_t materialId; //Every triangle of the instance uses it
+};
+
+//Structure of arrays view over mesh instances, pointers point into one scene buffer (see Scene).
+//The scene BVH is the top level over instances, each instance traverses the bottom level BVH of its geometry
+struct InstanceSet {
+	const InstanceData* instances = nullptr;
+	const MeshGeometry* geometries = nullptr;
+	const BVHNode* nodes = nullptr; //Bottom level nodes of every geometry
+	const glm::vec3* vertices = nullptr; //Shared with TriangleSet
+	const glm::vec3* normals = nullptr;
+	const glm::u32vec3* indices = nullptr; //Triangles of every geometry, each range in its own leaf order
+	Material** materials = nullptr; //Only needed by the virtual material path
+	uint32_t count = 0;
+
+	__host__ __device__ uint32_t size() const { return count; }
+
+	__host__ __device__ BVH<TriangleSet> geometry(uint32_t geometryId) const {
+		const MeshGeometry& g = geometries[geometryId];
+		TriangleSet triangles;
+		triangles.vertices = vertices;
+		triangles.normals = normals;
+		triangles.indices = indices + g.firstTriangle;
+		triangles.count = g.trianglesCount;
+		return BVH<TriangleSet>(nodes + g.firstNode, g.nodesCount, triangles);
+	}
+
+	__host__ __device__ bool hit(uint32_t idx, const Ray& r, Interval rayT, hitData& data) const {
+		float t;
+		uint32_t triangle;
+		if (!hitDistance(idx, r, rayT, t, triangle))
+			return false;
+
+		hitRecord(idx, triangle, r, rayT, t, data);
+		return true;
+	}
+
+	//triangle - the part of the instance that was hit, within the geometry's triangle range
+	__host__ __device__ bool hitDistance(uint32_t idx, const Ray& r, Interval rayT, float& t, uint32_t& triangle) const {
+		const InstanceData& instance = instances[idx];
+		uint32_t part;
+		return geometry(instance.geometryId).findClosest(Instance::toObject(r, instance.worldToObject), rayT, t, triangle, part);
+	}
+
+	__host__ __device__ void hitRecord(uint32_t idx, uint32_t triangle, const Ray& r, Interval rayT, float t, hitData& data) const {
+		const InstanceData& instance = instances[idx];
+		BVH<TriangleSet> blas = geometry(instance.geometryId);
+		Ray local = Instance::toObject(r, instance.worldToObject);
+
+		data.materialId = instance.materialId;
+		data.mat = materials ? materials[data.materialId] : nullptr;
+		blas.getPrimitives().fillGeometry(triangle, local, t, data);
+		Instance::toWorld(r, instance.worldToObject, data);
+	}
+
+	__host__ __device__ uint32_t getMaterialId(uint32_t idx) const { return instances[idx].materialId; }
+
+	__host__ __device__ AABB boundingBox(uint32_t idx) const {
+		const InstanceData& instance = instances[idx];
+		return Instance::transformBounds(nodes[geometries[instance.geometryId].firstNode].bounds, instance.objectToWorld);
+	}
+};
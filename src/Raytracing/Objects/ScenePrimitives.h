@@ -0,0 +1,55 @@
+#pragma once
+#include "SphereSet.h"
+#include "TriangleSet.h"
+#include "InstanceSet.h"
+
+//Every primitive of a Scene: spheres first, then triangles, then mesh instances. Scene::buildBVH gives each kind
+//its own subtree, so each stays in its own index range and a branch or two picks the test
+struct ScenePrimitives {
+	SphereSet spheres;
+	TriangleSet triangles;
+	InstanceSet instances;
+
+	__host__ __device__ uint32_t size() const { return spheres.count + triangles.count + instances.count; }
+
+	__host__ __device__ bool hit(uint32_t idx, const Ray& r, Interval rayT, hitData& data) const {
+		if (idx < spheres.count)
+			return spheres.hit(idx, r, rayT, data);
+		idx -= spheres.count;
+		return idx < triangles.count ? triangles.hit(idx, r, rayT, data) : instances.hit(idx - triangles.count, r, rayT, data);
+	}
+
+	__host__ __device__ bool hitDistance(uint32_t idx, const Ray& r, Interval rayT, float& t, uint32_t& part) const {
+		if (idx < spheres.count)
+			return spheres.hitDistance(idx, r, rayT, t, part);
+		idx -= spheres.count;
+		return idx < triangles.count ? triangles.hitDistance(idx, r, rayT, t, part)
+			: instances.hitDistance(idx - triangles.count, r, rayT, t, part);
+	}
+
+	__host__ __device__ void hitRecord(uint32_t idx, uint32_t part, const Ray& r, Interval rayT, float t, hitData& data) const {
+		if (idx < spheres.count) {
+			spheres.hitRecord(idx, part, r, rayT, t, data);
+			return;
+		}
+		idx -= spheres.count;
+		if (idx < triangles.count)
+			triangles.hitRecord(idx, part, r, rayT, t, data);
+		else
+			instances.hitRecord(idx - triangles.count, part, r, rayT, t, data);
+	}
+
+	__host__ __device__ uint32_t getMaterialId(uint32_t idx) const {
+		if (idx < spheres.count)
+			return spheres.getMaterialId(idx);
+		idx -= spheres.count;
+		return idx < triangles.count ? triangles.getMaterialId(idx) : instances.getMaterialId(idx - triangles.count);
+	}
+
+	__host__ __device__ AABB boundingBox(uint32_t idx) const {
+		if (idx < spheres.count)
+			return spheres.boundingBox(idx);
+		idx -= spheres.count;
+		return idx < triangles.count ? triangles.boundingBox(idx) : instances.boundingBox(idx - triangles.count);
+	}
+};
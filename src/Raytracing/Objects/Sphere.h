@@ -4,9 +4,35 @@
 class Sphere : public Hittable
 {
 public:
-	__device__ Sphere(const glm::vec3& center, float radius, Material* mat) :
-		center(center), radius(radius < 0 ? 0 : radius), mat(mat) {}
-	__device__ bool hit(const Ray& r, Interval rayT, hitData& data) const {
+	//materialId - the MaterialTable entry of mat, for the table dispatch path
+	__host__ __device__ Sphere(const glm::vec3& center, float radius, Material* mat, uint32_t materialId) :
+		center(center), radius(radius < 0 ? 0 : radius), mat(mat), materialId(materialId) {}
+	__host__ __device__ bool hit(const Ray& r, Interval rayT, hitData& data) const {
+		float root;
+		if (!intersect(center, radius, r, rayT, root))
+			return false;
+
+		hitRecord(r, rayT, root, data);
+		return true;
+	}
+
+	__host__ __device__ bool hitDistance(const Ray& r, Interval rayT, float& t) const {
+		return intersect(center, radius, r, rayT, t);
+	}
+
+	__host__ __device__ void hitRecord(const Ray& r, Interval rayT, float t, hitData& data) const {
+		data.mat = mat;
+		data.materialId = materialId;
+		fillRecord(center, radius, r, t, data);
+	}
+
+	__host__ __device__ AABB boundingBox() const {
+		glm::vec3 r(radius, radius, radius);
+		return AABB(center - r, center + r);
+	}
+
+	//Shared with SphereSet, root is the nearest solution inside rayT
+	__host__ __device__ static inline bool intersect(const glm::vec3& center, float radius, const Ray& r, Interval rayT, float& root) {
 		//oc = C - Q
 		glm::vec3 oc = center - r.origin();
 		//elementy rownania kwadratowego
@@ -20,24 +46,27 @@ public:
 
 		float deltaSqr = sqrt(delta);
 		//Nearest solution that lies within range
-		float root = (h - deltaSqr) / a;
+		root = (h - deltaSqr) / a;
 		if (!rayT.surrounds(root)) {
 			root = (h + deltaSqr) / a;
 			if (!rayT.surrounds(root))
 				return false;
 		}
 
-		data.t = root;
-		data.p = r.at(root);
-		data.mat = mat;
-		glm::dvec3 outwardNormal = (data.p - center) / radius;
-		data.setFaceNormal(r, outwardNormal);
-
 		return true;
 	}
 
+	//Surface point and normal at distance t, shared with SphereSet
+	__host__ __device__ static inline void fillRecord(const glm::vec3& center, float radius, const Ray& r, float t, hitData& data) {
+		data.t = t;
+		data.p = r.at(t);
+		glm::vec3 outwardNormal = (data.p - center) / radius;
+		data.setFaceNormal(r, outwardNormal);
+	}
+
 private:
 	glm::vec3 center;
 	float radius;
 	Material* mat;
-};
\ No newline at end of file
+	uint32_t materialId;
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include "Sphere.h"
+
+//Structure of arrays view over spheres, pointers point into one scene buffer (see Scene)
+struct SphereSet {
+	const glm::vec3* centers = nullptr;
+	const float* radii = nullptr;
+	const uint32_t* materialIds = nullptr;
+	Material** materials = nullptr; //Only needed by the virtual material path
+	uint32_t count = 0;
+
+	__host__ __device__ uint32_t size() const { return count; }
+
+	__host__ __device__ bool hit(uint32_t idx, const Ray& r, Interval rayT, hitData& data) const {
+		float root;
+		uint32_t part = 0;
+		if (!hitDistance(idx, r, rayT, root, part))
+			return false;
+
+		hitRecord(idx, part, r, rayT, root, data);
+		return true;
+	}
+
+	//A sphere is one part, part is left alone and ignored by hitRecord
+	__host__ __device__ bool hitDistance(uint32_t idx, const Ray& r, Interval rayT, float& t, uint32_t& part) const {
+		return Sphere::intersect(centers[idx], radii[idx], r, rayT, t);
+	}
+
+	__host__ __device__ void hitRecord(uint32_t idx, uint32_t part, const Ray& r, Interval rayT, float t, hitData& data) const {
+		data.materialId = materialIds[idx];
+		data.mat = materials ? materials[data.materialId] : nullptr;
+		Sphere::fillRecord(centers[idx], radii[idx], r, t, data);
+	}
+
+	__host__ __device__ uint32_t getMaterialId(uint32_t idx) const { return materialIds[idx]; }
+
+	__host__ __device__ AABB boundingBox(uint32_t idx) const {
+		glm::vec3 r(radii[idx], radii[idx], radii[idx]);
+		return AABB(centers[idx] - r, centers[idx] + r);
+	}
+};
@@ -0,0 +1,331 @@
+#include "pch.h"
+#include "SphereSimd.h"
+#include "../../Utils/CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define SPHERE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+//GCC and Clang only emit wider instructions in functions that ask for them, MSVC takes the intrinsics anywhere.
+//No fused multiply-adds (AVX-512 brings FMA along and GCC would contract), they round differently than Sphere::intersect
+#if defined(__clang__)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#elif defined(__GNUC__)
+#define SIMD_TARGET(isa) __attribute__((target(isa), optimize("fp-contract=off")))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+namespace
+{
+	constexpr uint32_t blockSize = 16;
+
+	//Sphere::intersect with the dot products written out in the order glm evaluates them
+	inline bool intersect(float cx, float cy, float cz, float radius, const glm::vec3& o, const glm::vec3& d, float a,
+		float tMin, float tMax, float& root)
+	{
+		float ocx = cx - o.x, ocy = cy - o.y, ocz = cz - o.z;
+		float h = (d.x * ocx + d.y * ocy) + d.z * ocz;
+		float c = ((ocx * ocx + ocy * ocy) + ocz * ocz) - radius * radius;
+
+		float delta = h * h - a * c;
+		if (delta < 0)
+			return false;
+
+		float deltaSqr = std::sqrt(delta);
+		root = (h - deltaSqr) / a;
+		if (!(tMin < root && root < tMax)) {
+			root = (h + deltaSqr) / a;
+			if (!(tMin < root && root < tMax))
+				return false;
+		}
+		return true;
+	}
+
+	inline float lengthSquared(const glm::vec3& d)
+	{
+		return (d.x * d.x + d.y * d.y) + d.z * d.z;
+	}
+
+	//Closest of the per lane results, equal distances go to the lower index like in a sequential scan
+	uint32_t reduceLanes(const float* laneT, const uint32_t* laneIds, uint32_t lanes, float& t)
+	{
+		uint32_t best = SphereSimd::noHit;
+		for (uint32_t l = 0; l < lanes; l++) {
+			if (laneIds[l] == SphereSimd::noHit)
+				continue;
+			if (best == SphereSimd::noHit || laneT[l] < t || (laneT[l] == t && laneIds[l] < best)) {
+				t = laneT[l];
+				best = laneIds[l];
+			}
+		}
+		return best;
+	}
+}
+
+SphereSimd::SphereSimd(const glm::vec3* centers, const float* sphereRadii, uint32_t count, Isa isa)
+	: count(count), isa(std::min(isa, bestIsa()))
+{
+	size_t padded = (size_t(count) + blockSize - 1) / blockSize * blockSize;
+	float nan = std::numeric_limits<float>::quiet_NaN();
+	x.assign(padded, nan);
+	y.assign(padded, nan);
+	z.assign(padded, nan);
+	radii.assign(padded, 0.0f);
+	for (uint32_t i = 0; i < count; i++) {
+		x[i] = centers[i].x;
+		y[i] = centers[i].y;
+		z[i] = centers[i].z;
+		radii[i] = sphereRadii[i];
+	}
+}
+
+SphereSimd::Isa SphereSimd::bestIsa()
+{
+#ifdef SPHERE_SIMD_X86
+	if (CpuFeatures::hasAVX512())
+		return Isa::AVX512;
+	if (CpuFeatures::hasAVX2())
+		return Isa::AVX2;
+#endif
+	return Isa::Scalar;
+}
+
+const char* SphereSimd::name(Isa isa)
+{
+	switch (isa) {
+	case Isa::AVX2: return "AVX2";
+	case Isa::AVX512: return "AVX-512";
+	default: return "scalar";
+	}
+}
+
+uint32_t SphereSimd::closestHit(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& t) const
+{
+#ifdef SPHERE_SIMD_X86
+	if (isa == Isa::AVX512)
+		return closestHitAVX512(origin, direction, tMin, tMax, t);
+	if (isa == Isa::AVX2)
+		return closestHitAVX2(origin, direction, tMin, tMax, t);
+#endif
+	return closestHitScalar(origin, direction, tMin, tMax, t);
+}
+
+void SphereSimd::closestHits(const glm::vec3* origins, const glm::vec3* directions, uint32_t raysCount, float tMin, float tMax,
+	float* t, uint32_t* ids) const
+{
+	raysCount = std::min(raysCount, packetSize);
+#ifdef SPHERE_SIMD_X86
+	//8 rays fill an AVX2 register, AVX-512 has nothing to add here
+	if (isa != Isa::Scalar) {
+		closestHitsAVX2(origins, directions, raysCount, tMin, tMax, t, ids);
+		return;
+	}
+#endif
+	for (uint32_t r = 0; r < raysCount; r++)
+		ids[r] = closestHitScalar(origins[r], directions[r], tMin, tMax, t[r]);
+}
+
+uint32_t SphereSimd::closestHitScalar(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& t) const
+{
+	float a = lengthSquared(direction);
+	uint32_t best = noHit;
+	float closest = tMax;
+	for (uint32_t i = 0; i < count; i++) {
+		float root;
+		if (intersect(x[i], y[i], z[i], radii[i], origin, direction, a, tMin, closest, root)) {
+			closest = root;
+			best = i;
+		}
+	}
+	t = closest;
+	return best;
+}
+
+#ifdef SPHERE_SIMD_X86
+//One ray, 8 spheres per step. Every lane keeps its own closest hit and is clipped by it, the lanes are merged at the end
+SIMD_TARGET("avx2")
+uint32_t SphereSimd::closestHitAVX2(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& t) const
+{
+	const __m256 ox = _mm256_set1_ps(origin.x), oy = _mm256_set1_ps(origin.y), oz = _mm256_set1_ps(origin.z);
+	const __m256 dx = _mm256_set1_ps(direction.x), dy = _mm256_set1_ps(direction.y), dz = _mm256_set1_ps(direction.z);
+	const __m256 a = _mm256_set1_ps(lengthSquared(direction));
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 minT = _mm256_set1_ps(tMin);
+
+	__m256 closest = _mm256_set1_ps(tMax);
+	__m256i best = _mm256_set1_epi32(int(noHit));
+	__m256i ids = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i step = _mm256_set1_epi32(8);
+
+	uint32_t end = (count + 7) / 8 * 8;
+	for (uint32_t i = 0; i < end; i += 8, ids = _mm256_add_epi32(ids, step)) {
+		__m256 ocx = _mm256_sub_ps(_mm256_loadu_ps(&x[i]), ox);
+		__m256 ocy = _mm256_sub_ps(_mm256_loadu_ps(&y[i]), oy);
+		__m256 ocz = _mm256_sub_ps(_mm256_loadu_ps(&z[i]), oz);
+		__m256 radius = _mm256_loadu_ps(&radii[i]);
+
+		__m256 h = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, ocx), _mm256_mul_ps(dy, ocy)), _mm256_mul_ps(dz, ocz));
+		__m256 c = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz));
+		c = _mm256_sub_ps(c, _mm256_mul_ps(radius, radius));
+		__m256 delta = _mm256_sub_ps(_mm256_mul_ps(h, h), _mm256_mul_ps(a, c));
+
+		//NaN padding fails the ordered compare
+		__m256 valid = _mm256_cmp_ps(delta, zero, _CMP_GE_OQ);
+		if (_mm256_testz_ps(valid, valid))
+			continue;
+
+		__m256 deltaSqr = _mm256_sqrt_ps(_mm256_max_ps(delta, zero));
+		__m256 nearT = _mm256_div_ps(_mm256_sub_ps(h, deltaSqr), a);
+		__m256 farT = _mm256_div_ps(_mm256_add_ps(h, deltaSqr), a);
+		__m256 nearHit = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(minT, nearT, _CMP_LT_OQ), _mm256_cmp_ps(nearT, closest, _CMP_LT_OQ)));
+		__m256 farHit = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(minT, farT, _CMP_LT_OQ), _mm256_cmp_ps(farT, closest, _CMP_LT_OQ)));
+		__m256 hit = _mm256_or_ps(nearHit, farHit);
+
+		closest = _mm256_blendv_ps(closest, _mm256_blendv_ps(farT, nearT, nearHit), hit);
+		best = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(best), _mm256_castsi256_ps(ids), hit));
+	}
+
+	alignas(32) float laneT[8];
+	alignas(32) uint32_t laneIds[8];
+	_mm256_store_ps(laneT, closest);
+	_mm256_store_si256(reinterpret_cast<__m256i*>(laneIds), best);
+	t = tMax;
+	return reduceLanes(laneT, laneIds, 8, t);
+}
+
+//Same with 16 lanes and mask registers
+SIMD_TARGET("avx512f")
+uint32_t SphereSimd::closestHitAVX512(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& t) const
+{
+	const __m512 ox = _mm512_set1_ps(origin.x), oy = _mm512_set1_ps(origin.y), oz = _mm512_set1_ps(origin.z);
+	const __m512 dx = _mm512_set1_ps(direction.x), dy = _mm512_set1_ps(direction.y), dz = _mm512_set1_ps(direction.z);
+	const __m512 a = _mm512_set1_ps(lengthSquared(direction));
+	const __m512 zero = _mm512_setzero_ps();
+	const __m512 minT = _mm512_set1_ps(tMin);
+
+	__m512 closest = _mm512_set1_ps(tMax);
+	__m512i best = _mm512_set1_epi32(int(noHit));
+	__m512i ids = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m512i step = _mm512_set1_epi32(16);
+
+	uint32_t end = (count + blockSize - 1) / blockSize * blockSize;
+	for (uint32_t i = 0; i < end; i += 16, ids = _mm512_add_epi32(ids, step)) {
+		__m512 ocx = _mm512_sub_ps(_mm512_loadu_ps(&x[i]), ox);
+		__m512 ocy = _mm512_sub_ps(_mm512_loadu_ps(&y[i]), oy);
+		__m512 ocz = _mm512_sub_ps(_mm512_loadu_ps(&z[i]), oz);
+		__m512 radius = _mm512_loadu_ps(&radii[i]);
+
+		__m512 h = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, ocx), _mm512_mul_ps(dy, ocy)), _mm512_mul_ps(dz, ocz));
+		__m512 c = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ocx, ocx), _mm512_mul_ps(ocy, ocy)), _mm512_mul_ps(ocz, ocz));
+		c = _mm512_sub_ps(c, _mm512_mul_ps(radius, radius));
+		__m512 delta = _mm512_sub_ps(_mm512_mul_ps(h, h), _mm512_mul_ps(a, c));
+
+		__mmask16 valid = _mm512_cmp_ps_mask(delta, zero, _CMP_GE_OQ);
+		if (!valid)
+			continue;
+
+		__m512 deltaSqr = _mm512_sqrt_ps(_mm512_max_ps(delta, zero));
+		__m512 nearT = _mm512_div_ps(_mm512_sub_ps(h, deltaSqr), a);
+		__m512 farT = _mm512_div_ps(_mm512_add_ps(h, deltaSqr), a);
+		__mmask16 nearHit = valid & _mm512_cmp_ps_mask(minT, nearT, _CMP_LT_OQ) & _mm512_cmp_ps_mask(nearT, closest, _CMP_LT_OQ);
+		__mmask16 farHit = valid & _mm512_cmp_ps_mask(minT, farT, _CMP_LT_OQ) & _mm512_cmp_ps_mask(farT, closest, _CMP_LT_OQ);
+		__mmask16 hit = nearHit | farHit;
+
+		closest = _mm512_mask_blend_ps(hit, closest, _mm512_mask_blend_ps(nearHit, farT, nearT));
+		best = _mm512_mask_blend_epi32(hit, best, ids);
+	}
+
+	alignas(64) float laneT[16];
+	alignas(64) uint32_t laneIds[16];
+	_mm512_store_ps(laneT, closest);
+	_mm512_store_si512(laneIds, best);
+	t = tMax;
+	return reduceLanes(laneT, laneIds, 16, t);
+}
+
+//8 rays, one sphere per step: the sphere is broadcast and every lane is a ray with its own closest hit
+SIMD_TARGET("avx2")
+void SphereSimd::closestHitsAVX2(const glm::vec3* origins, const glm::vec3* directions, uint32_t raysCount, float tMin, float tMax,
+	float* t, uint32_t* ids) const
+{
+	//Missing rays get a NaN direction, so they never hit
+	alignas(32) float rays[7][8];
+	float nan = std::numeric_limits<float>::quiet_NaN();
+	for (uint32_t r = 0; r < 8; r++) {
+		glm::vec3 o = r < raysCount ? origins[r] : glm::vec3(0.0f);
+		glm::vec3 d = r < raysCount ? directions[r] : glm::vec3(nan);
+		rays[0][r] = o.x;
+		rays[1][r] = o.y;
+		rays[2][r] = o.z;
+		rays[3][r] = d.x;
+		rays[4][r] = d.y;
+		rays[5][r] = d.z;
+		rays[6][r] = lengthSquared(d);
+	}
+	const __m256 ox = _mm256_load_ps(rays[0]), oy = _mm256_load_ps(rays[1]), oz = _mm256_load_ps(rays[2]);
+	const __m256 dx = _mm256_load_ps(rays[3]), dy = _mm256_load_ps(rays[4]), dz = _mm256_load_ps(rays[5]);
+	const __m256 a = _mm256_load_ps(rays[6]);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 minT = _mm256_set1_ps(tMin);
+
+	__m256 closest = _mm256_set1_ps(tMax);
+	__m256i best = _mm256_set1_epi32(int(noHit));
+	for (uint32_t i = 0; i < count; i++) {
+		__m256 ocx = _mm256_sub_ps(_mm256_set1_ps(x[i]), ox);
+		__m256 ocy = _mm256_sub_ps(_mm256_set1_ps(y[i]), oy);
+		__m256 ocz = _mm256_sub_ps(_mm256_set1_ps(z[i]), oz);
+		__m256 radius = _mm256_set1_ps(radii[i]);
+
+		__m256 h = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, ocx), _mm256_mul_ps(dy, ocy)), _mm256_mul_ps(dz, ocz));
+		__m256 c = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz));
+		c = _mm256_sub_ps(c, _mm256_mul_ps(radius, radius));
+		__m256 delta = _mm256_sub_ps(_mm256_mul_ps(h, h), _mm256_mul_ps(a, c));
+
+		__m256 valid = _mm256_cmp_ps(delta, zero, _CMP_GE_OQ);
+		if (_mm256_testz_ps(valid, valid))
+			continue;
+
+		__m256 deltaSqr = _mm256_sqrt_ps(_mm256_max_ps(delta, zero));
+		__m256 nearT = _mm256_div_ps(_mm256_sub_ps(h, deltaSqr), a);
+		__m256 farT = _mm256_div_ps(_mm256_add_ps(h, deltaSqr), a);
+		__m256 nearHit = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(minT, nearT, _CMP_LT_OQ), _mm256_cmp_ps(nearT, closest, _CMP_LT_OQ)));
+		__m256 farHit = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(minT, farT, _CMP_LT_OQ), _mm256_cmp_ps(farT, closest, _CMP_LT_OQ)));
+		__m256 hit = _mm256_or_ps(nearHit, farHit);
+
+		closest = _mm256_blendv_ps(closest, _mm256_blendv_ps(farT, nearT, nearHit), hit);
+		best = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(best), _mm256_castsi256_ps(_mm256_set1_epi32(int(i))), hit));
+	}
+
+	alignas(32) float laneT[8];
+	alignas(32) uint32_t laneIds[8];
+	_mm256_store_ps(laneT, closest);
+	_mm256_store_si256(reinterpret_cast<__m256i*>(laneIds), best);
+	for (uint32_t r = 0; r < raysCount; r++) {
+		t[r] = laneT[r];
+		ids[r] = laneIds[r];
+	}
+}
+#else
+uint32_t SphereSimd::closestHitAVX2(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& t) const
+{
+	return closestHitScalar(origin, direction, tMin, tMax, t);
+}
+
+uint32_t SphereSimd::closestHitAVX512(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& t) const
+{
+	return closestHitScalar(origin, direction, tMin, tMax, t);
+}
+
+void SphereSimd::closestHitsAVX2(const glm::vec3* origins, const glm::vec3* directions, uint32_t raysCount, float tMin, float tMax,
+	float* t, uint32_t* ids) const
+{
+	for (uint32_t r = 0; r < raysCount; r++)
+		ids[r] = closestHitScalar(origins[r], directions[r], tMin, tMax, t[r]);
+}
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#include "glm/glm.hpp"
+#include <cstdint>
+#include <vector>
+
+//Host only closest hit of rays against a flat list of spheres, 8 (AVX2) or 16 (AVX-512) spheres per
+//instruction. Centers and radii are copied into padded structure of arrays, the instruction set is picked
+//at runtime and falls back to a scalar loop. Same arithmetic as Sphere::intersect, so hits match it exactly
+//(Microbenchmarks::run counts every ray that doesn't and --benchmark fails on any)
+class SphereSimd
+{
+public:
+	enum class Isa { Scalar, AVX2, AVX512 };
+
+	static constexpr uint32_t noHit = 0xffffffffu;
+	static constexpr uint32_t packetSize = 8;
+
+	//isa above what this CPU supports drops to bestIsa()
+	SphereSimd(const glm::vec3* centers, const float* radii, uint32_t count, Isa isa = bestIsa());
+
+	static Isa bestIsa();
+	static const char* name(Isa isa);
+
+	//Index of the closest sphere hit inside (tMin, tMax) and its distance, noHit when there is none
+	uint32_t closestHit(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& t) const;
+	//Up to packetSize rays against one sphere at a time, pays off for coherent rays (e.g. a camera tile) that mostly
+	//hit the same spheres. ids[i] is noHit for rays that miss everything
+	void closestHits(const glm::vec3* origins, const glm::vec3* directions, uint32_t raysCount, float tMin, float tMax,
+		float* t, uint32_t* ids) const;
+
+	inline Isa getIsa() const { return isa; }
+	inline uint32_t size() const { return count; }
+
+private:
+	uint32_t closestHitScalar(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& t) const;
+	uint32_t closestHitAVX2(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& t) const;
+	uint32_t closestHitAVX512(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& t) const;
+	void closestHitsAVX2(const glm::vec3* origins, const glm::vec3* directions, uint32_t raysCount, float tMin, float tMax,
+		float* t, uint32_t* ids) const;
+
+	//Padded to a whole number of 16 wide blocks with NaN centers, which never hit
+	std::vector<float> x, y, z, radii;
+	uint32_t count;
+	Isa isa;
+};
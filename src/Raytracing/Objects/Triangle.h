@@ -0,0 +1,85 @@
+#pragma once
+#include "../Hittable.h"
+
+//Triangle tests shared by TriangleSet, vertices are passed in so meshes can keep them in shared indexed arrays
+struct Triangle
+{
+	//Watertight test (Woop, Benthin, Wald - Watertight Ray/Triangle Intersection). Rays through a shared
+	//edge or vertex hit at least one of the triangles, so closed meshes never leak light through cracks
+	__host__ __device__ static inline bool intersect(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const Ray& r, Interval rayT, float& t) {
+		const glm::vec3& dir = r.direction();
+		glm::vec3 absDir = glm::abs(dir);
+
+		//Ray space where the ray runs along +kz
+		int kz = absDir.x > absDir.y ? (absDir.x > absDir.z ? 0 : 2) : (absDir.y > absDir.z ? 1 : 2);
+		int kx = kz == 2 ? 0 : kz + 1;
+		int ky = kx == 2 ? 0 : kx + 1;
+		if (dir[kz] < 0.0f) {
+			int k = kx; kx = ky; ky = k;
+		}
+
+		float sz = 1.0f / dir[kz];
+		float sx = dir[kx] * sz;
+		float sy = dir[ky] * sz;
+
+		glm::vec3 a = p0 - r.origin();
+		glm::vec3 b = p1 - r.origin();
+		glm::vec3 c = p2 - r.origin();
+
+		float ax = a[kx] - sx * a[kz], ay = a[ky] - sy * a[kz];
+		float bx = b[kx] - sx * b[kz], by = b[ky] - sy * b[kz];
+		float cx = c[kx] - sx * c[kz], cy = c[ky] - sy * c[kz];
+
+		float u = cx * by - cy * bx;
+		float v = ax * cy - ay * cx;
+		float w = bx * ay - by * ax;
+
+		//Ray exactly on an edge, float can't tell the side
+		if (u == 0.0f || v == 0.0f || w == 0.0f) {
+			u = float(double(cx) * double(by) - double(cy) * double(bx));
+			v = float(double(ax) * double(cy) - double(ay) * double(cx));
+			w = float(double(bx) * double(ay) - double(by) * double(ax));
+		}
+
+		if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+			return false;
+
+		float det = u + v + w;
+		if (det == 0.0f)
+			return false;
+
+		float tScaled = u * (sz * a[kz]) + v * (sz * b[kz]) + w * (sz * c[kz]);
+		t = tScaled / det;
+		return rayT.surrounds(t);
+	}
+
+	//Surface point and normal at distance t. With vertex normals (n0 == nullptr - flat) the shading normal is
+	//interpolated, front face still comes from the geometric normal so refraction picks the right side
+	__host__ __device__ static inline void fillRecord(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3* n0,
+		const glm::vec3* n1, const glm::vec3* n2, const Ray& r, float t, hitData& data) {
+		data.t = t;
+		data.p = r.at(t);
+
+		glm::vec3 e1 = p1 - p0, e2 = p2 - p0;
+		glm::vec3 geometric = glm::cross(e1, e2);
+		float area = glm::dot(geometric, geometric);
+		if (area > 0.0f)
+			geometric /= sqrtf(area);
+
+		data.frontFace = glm::dot(r.direction(), geometric) < 0;
+		glm::vec3 normal = geometric;
+		if (n0 && area > 0.0f) {
+			glm::vec3 d = data.p - p0;
+			float b1 = glm::dot(glm::cross(d, e2), geometric) / sqrtf(area);
+			float b2 = glm::dot(glm::cross(e1, d), geometric) / sqrtf(area);
+			glm::vec3 interpolated = (1.0f - b1 - b2) * *n0 + b1 * *n1 + b2 * *n2;
+			float length = glm::length(interpolated);
+			if (length > 0.0f) {
+				normal = interpolated / length;
+				if (glm::dot(normal, geometric) < 0.0f)
+					normal = -normal;
+			}
+		}
+		data.normal = data.frontFace ? normal : -normal;
+	}
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include "glm/glm.hpp"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+//Host side indexed mesh, e.g. from ObjLoader, before Scene::addMesh copies it into the scene arrays
+struct TriangleMesh {
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec3> normals; //Empty or one per vertex
+	std::vector<glm::u32vec3> indices;
+
+	inline uint32_t getTrianglesCount() const { return static_cast<uint32_t>(indices.size()); }
+	inline uint32_t getVerticesCount() const { return static_cast<uint32_t>(vertices.size()); }
+
+	void bounds(glm::vec3& min, glm::vec3& max) const {
+		min = glm::vec3(std::numeric_limits<float>::infinity());
+		max = -min;
+		for (const glm::vec3& v : vertices) {
+			min = glm::min(min, v);
+			max = glm::max(max, v);
+		}
+	}
+
+	//Scales and moves the mesh so its bounds fit a cube of size edge, centered on x and z with the bottom at base
+	void fit(const glm::vec3& base, float edge) {
+		glm::vec3 min, max;
+		bounds(min, max);
+		glm::vec3 extent = max - min;
+		float largest = std::max(extent.x, std::max(extent.y, extent.z));
+		if (vertices.empty() || largest <= 0.0f)
+			return;
+
+		float scale = edge / largest;
+		glm::vec3 offset = base - glm::vec3(0.5f * (min.x + max.x), min.y, 0.5f * (min.z + max.z)) * scale;
+		for (glm::vec3& v : vertices)
+			v = v * scale + offset;
+	}
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include "Triangle.h"
+
+//Structure of arrays view over indexed triangles, pointers point into one scene buffer (see Scene).
+//Vertices are shared between triangles, a triangle is only its three indices and a material id
+struct TriangleSet {
+	const glm::vec3* vertices = nullptr;
+	const glm::vec3* normals = nullptr; //Per vertex, nullptr - flat shading
+	const glm::u32vec3* indices = nullptr;
+	const uint32_t* materialIds = nullptr; //nullptr only under InstanceSet, which never asks for materials
+	Material** materials = nullptr; //Only needed by the virtual material path
+	uint32_t count = 0;
+
+	__host__ __device__ uint32_t size() const { return count; }
+
+	__host__ __device__ bool hit(uint32_t idx, const Ray& r, Interval rayT, hitData& data) const {
+		float t;
+		uint32_t part = 0;
+		if (!hitDistance(idx, r, rayT, t, part))
+			return false;
+
+		hitRecord(idx, part, r, rayT, t, data);
+		return true;
+	}
+
+	//A triangle is one part, part is left alone and ignored by hitRecord
+	__host__ __device__ bool hitDistance(uint32_t idx, const Ray& r, Interval rayT, float& t, uint32_t& part) const {
+		glm::u32vec3 tri = indices[idx];
+		return Triangle::intersect(vertices[tri.x], vertices[tri.y], vertices[tri.z], r, rayT, t);
+	}
+
+	__host__ __device__ void hitRecord(uint32_t idx, uint32_t part, const Ray& r, Interval rayT, float t, hitData& data) const {
+		data.materialId = materialIds[idx];
+		data.mat = materials ? materials[data.materialId] : nullptr;
+		fillGeometry(idx, r, t, data);
+	}
+
+	//Everything but the material, for InstanceSet where the instance picks it
+	__host__ __device__ void fillGeometry(uint32_t idx, const Ray& r, float t, hitData& data) const {
+		glm::u32vec3 tri = indices[idx];
+		if (normals)
+			Triangle::fillRecord(vertices[tri.x], vertices[tri.y], vertices[tri.z], &normals[tri.x], &normals[tri.y], &normals[tri.z], r, t, data);
+		else
+			Triangle::fillRecord(vertices[tri.x], vertices[tri.y], vertices[tri.z], nullptr, nullptr, nullptr, r, t, data);
+	}
+
+	__host__ __device__ uint32_t getMaterialId(uint32_t idx) const { return materialIds[idx]; }
+
+	__host__ __device__ AABB boundingBox(uint32_t idx) const {
+		glm::u32vec3 tri = indices[idx];
+		AABB box(vertices[tri.x], vertices[tri.x]);
+		box.grow(vertices[tri.y]);
+		box.grow(vertices[tri.z]);
+		return box;
+	}
+};
@@ -5,12 +5,12 @@
 class Ray
 {
 public:
-	__device__ Ray(const glm::vec3& origin, const glm::vec3& direction) : orig(origin), dir(direction) {}
+	__host__ __device__ Ray(const glm::vec3& origin, const glm::vec3& direction) : orig(origin), dir(direction) {}
 
-	__device__ const glm::vec3& origin() const { return orig; }
-	__device__ const glm::vec3& direction() const { return dir; }
+	__host__ __device__ const glm::vec3& origin() const { return orig; }
+	__host__ __device__ const glm::vec3& direction() const { return dir; }
 
-	__device__ glm::vec3 at(float t) const {
+	__host__ __device__ glm::vec3 at(float t) const {
 		return orig + t * dir;
 	}
 private:
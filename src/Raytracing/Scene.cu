@@ -0,0 +1,690 @@
+#include "pch.h"
+#include "Scene.h"
+#include "../Utils/CudaErrors.h"
+
+#include <cstdio>
+#include <fstream>
+#include <type_traits>
+
+namespace {
+	constexpr size_t bufferAlignment = 256;
+	constexpr char cacheMagic[8] = "RTSCENE";
+	constexpr uint32_t cacheVersion = 2;
+
+	//File: header, one CacheSection per visitSections entry, then the image from the next aligned offset.
+	//Native byte order and struct layouts, element sizes are checked on load
+	struct CacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t sectionsCount;
+		uint64_t key;
+		uint64_t deviceImageSize; //Leading part of the image that upload() copies as is
+		uint64_t imageSize;
+		uint64_t checksum; //cacheChecksum over the sections in visitSections order, padding isn't read so it isn't covered
+	};
+
+	struct CacheSection {
+		uint64_t offset; //From the image start
+		uint64_t count;
+		uint32_t elementSize;
+		uint32_t padding;
+	};
+
+	size_t cacheImageStart(size_t sectionsCount) {
+		return (sizeof(CacheHeader) + sectionsCount * sizeof(CacheSection) + bufferAlignment - 1) / bufferAlignment * bufferAlignment;
+	}
+
+	//FNV-1a over 8 byte words, every step is a bijection of the running hash so any one changed word shows
+	uint64_t cacheChecksum(const unsigned char* bytes, size_t size, uint64_t hash) {
+		constexpr uint64_t prime = 1099511628211ull;
+		size_t i = 0;
+		for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, bytes + i, sizeof(word));
+			hash = (hash ^ word) * prime;
+		}
+		for (; i < size; i++)
+			hash = (hash ^ bytes[i]) * prime;
+		return hash;
+	}
+	constexpr uint64_t cacheChecksumSeed = 14695981039346656037ull;
+
+	//Walks the tree the way traversal does: children in range, every node reached once (a cycle would never end)
+	//and no interior node deeper than the traversal stack. Leaves have to stay inside primitivesCount
+	bool validTree(const BVHNode* nodes, size_t nodesCount, size_t primitivesCount) {
+		if (nodesCount == 0)
+			return false;
+
+		std::vector<bool> reached(nodesCount, false);
+		std::vector<glm::u32vec2> stack(1, glm::u32vec2(0, 1));
+		reached[0] = true;
+		while (!stack.empty()) {
+			glm::u32vec2 entry = stack.back();
+			stack.pop_back();
+
+			const BVHNode& node = nodes[entry.x];
+			if (node.isLeaf()) {
+				if (node.leftFirst > primitivesCount || node.primCount > primitivesCount - node.leftFirst)
+					return false;
+				continue;
+			}
+			if (nodesCount == 1)
+				continue; //Empty tree, the root has no children
+			if (entry.y >= static_cast<uint32_t>(BVHLimits::stackSize) || node.leftFirst >= nodesCount - 1)
+				return false;
+
+			for (uint32_t child = node.leftFirst; child < node.leftFirst + 2; child++) {
+				if (reached[child])
+					return false;
+				reached[child] = true;
+				stack.push_back(glm::u32vec2(child, entry.y + 1));
+			}
+		}
+		return true;
+	}
+
+	template<typename T, typename Index>
+	bool indicesBelow(const std::vector<T>& data, size_t limit, Index index) {
+		for (const T& element : data)
+			if (!index(element, limit))
+				return false;
+		return true;
+	}
+
+	size_t alignOffset(size_t offset) {
+		return (offset + bufferAlignment - 1) / bufferAlignment * bufferAlignment;
+	}
+
+	template<typename T>
+	size_t reserveSection(size_t& offset, const std::vector<T>& data) {
+		size_t sectionOffset = alignOffset(offset);
+		offset = sectionOffset + data.size() * sizeof(T);
+		return sectionOffset;
+	}
+
+	template<typename T>
+	void copySection(std::vector<unsigned char>& staging, size_t offset, const std::vector<T>& data) {
+		if (!data.empty())
+			memcpy(staging.data() + offset, data.data(), data.size() * sizeof(T));
+	}
+
+	template<typename T>
+	void reorder(std::vector<T>& data, const std::vector<uint32_t>& order) {
+		std::vector<T> reordered(data.size());
+		for (size_t i = 0; i < order.size(); i++)
+			reordered[i] = data[order[i]];
+		data.swap(reordered);
+	}
+}
+
+Scene::~Scene()
+{
+	freeDevice();
+}
+
+uint32_t Scene::addMaterial(const MaterialData& material)
+{
+	dropCache();
+	materials.push_back(material);
+	return static_cast<uint32_t>(materials.size() - 1);
+}
+
+uint32_t Scene::addSphere(const glm::vec3& center, float radius, uint32_t materialId)
+{
+	dropCache();
+	uint32_t id = static_cast<uint32_t>(sphereSlots.size());
+	sphereSlots.push_back(getSpheresCount());
+	sphereIds.push_back(id);
+
+	centers.push_back(center);
+	radii.push_back(radius < 0 ? 0 : radius);
+	materialIds.push_back(materialId);
+	return id;
+}
+
+void Scene::setSphereCenter(uint32_t sphereId, const glm::vec3& center)
+{
+	dropCache();
+	centers[sphereSlots[sphereId]] = center;
+}
+
+uint32_t Scene::addVertices(const TriangleMesh& mesh)
+{
+	dropCache();
+	uint32_t firstVertex = getVerticesCount();
+
+	//Meshes without normals next to ones with them get their geometric normal back through a zero normal
+	if (!mesh.normals.empty() && normals.empty())
+		normals.resize(vertices.size(), glm::vec3(0.0f));
+	vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+	if (!mesh.normals.empty())
+		normals.insert(normals.end(), mesh.normals.begin(), mesh.normals.end());
+	else if (!normals.empty())
+		normals.resize(vertices.size(), glm::vec3(0.0f));
+
+	return firstVertex;
+}
+
+void Scene::addMesh(const TriangleMesh& mesh, uint32_t materialId)
+{
+	uint32_t firstVertex = addVertices(mesh);
+
+	triangles.reserve(triangles.size() + mesh.indices.size());
+	for (const glm::u32vec3& tri : mesh.indices)
+		triangles.push_back(tri + firstVertex);
+	triangleMaterialIds.resize(triangles.size(), materialId);
+}
+
+uint32_t Scene::addGeometry(const TriangleMesh& mesh, BVHBuilder& builder)
+{
+	std::vector<AABB> bounds(mesh.indices.size());
+	for (size_t i = 0; i < mesh.indices.size(); i++) {
+		const glm::u32vec3& tri = mesh.indices[i];
+		bounds[i] = AABB(mesh.vertices[tri.x], mesh.vertices[tri.x]);
+		bounds[i].grow(mesh.vertices[tri.y]);
+		bounds[i].grow(mesh.vertices[tri.z]);
+	}
+	builder.build(bounds);
+
+	MeshGeometry geometry;
+	geometry.firstNode = static_cast<uint32_t>(geometryNodes.size());
+	geometry.nodesCount = static_cast<uint32_t>(builder.getNodes().size());
+	geometry.firstTriangle = static_cast<uint32_t>(geometryTriangles.size());
+	geometry.trianglesCount = mesh.getTrianglesCount();
+
+	//Node indices stay relative to the geometry, InstanceSet offsets the node pointer instead
+	geometryNodes.insert(geometryNodes.end(), builder.getNodes().begin(), builder.getNodes().end());
+
+	uint32_t firstVertex = addVertices(mesh);
+	geometryTriangles.reserve(geometryTriangles.size() + mesh.indices.size());
+	for (uint32_t idx : builder.getPrimitiveIndices())
+		geometryTriangles.push_back(mesh.indices[idx] + firstVertex);
+
+	geometries.push_back(geometry);
+	return static_cast<uint32_t>(geometries.size() - 1);
+}
+
+uint32_t Scene::addInstance(uint32_t geometryId, const glm::mat4& objectToWorld, uint32_t materialId)
+{
+	dropCache();
+	uint32_t id = static_cast<uint32_t>(instanceSlots.size());
+
+	InstanceData instance;
+	instance.objectToWorld = objectToWorld;
+	instance.worldToObject = glm::inverse(objectToWorld);
+	instance.geometryId = geometryId;
+	instance.materialId = materialId;
+
+	instanceSlots.push_back(getInstancesCount());
+	instanceIds.push_back(id);
+	instances.push_back(instance);
+	return id;
+}
+
+void Scene::setInstanceTransform(uint32_t instanceId, const glm::mat4& objectToWorld)
+{
+	dropCache();
+	InstanceData& instance = instances[instanceSlots[instanceId]];
+	instance.objectToWorld = objectToWorld;
+	instance.worldToObject = glm::inverse(objectToWorld);
+}
+
+std::vector<AABB> Scene::primitiveBounds(std::vector<uint32_t>& rangeEnds) const
+{
+	uint32_t spheresCount = getSpheresCount();
+	uint32_t trianglesEnd = spheresCount + getTrianglesCount();
+	std::vector<AABB> bounds(trianglesEnd + instances.size());
+	for (size_t i = 0; i < centers.size(); i++) {
+		glm::vec3 r(radii[i], radii[i], radii[i]);
+		bounds[i] = AABB(centers[i] - r, centers[i] + r);
+	}
+
+	TriangleSet triangleSet = getHostTriangles(nullptr);
+	for (uint32_t i = 0; i < triangleSet.size(); i++)
+		bounds[spheresCount + i] = triangleSet.boundingBox(i);
+
+	InstanceSet instanceSet = getHostInstances(nullptr);
+	for (uint32_t i = 0; i < instanceSet.size(); i++)
+		bounds[trianglesEnd + i] = instanceSet.boundingBox(i);
+
+	//Every kind under its own subtree, so ScenePrimitives can tell them apart by index
+	rangeEnds = { spheresCount, trianglesEnd };
+	return bounds;
+}
+
+void Scene::buildBVH(BVHBuilder& builder)
+{
+	std::vector<uint32_t> rangeEnds;
+	std::vector<AABB> bounds = primitiveBounds(rangeEnds);
+	builder.build(bounds, rangeEnds);
+	applyBVH(builder.getNodes(), builder.getPrimitiveIndices());
+}
+
+void Scene::buildBVH(LBVHBuilder& builder)
+{
+	std::vector<uint32_t> rangeEnds;
+	std::vector<AABB> bounds = primitiveBounds(rangeEnds);
+	builder.build(bounds, rangeEnds);
+	applyBVH(builder.getNodes(), builder.getPrimitiveIndices());
+}
+
+float Scene::refitBVH(BVHRefitter& refitter)
+{
+	dropCache();
+	//Both costs only count what the root reaches, the nodes linkTree hands to the refit. A depth limited LBVH
+	//leaves subtrees behind that are never refitted
+	if (nodeParents.empty()) {
+		BVHRefitter::linkTree(nodes, nodeParents, leafNodes);
+		builtCost = BVHBuilder::sahCost(nodes);
+	}
+
+	//Primitives are in leaf order already, so bounds index the way leaves do
+	std::vector<uint32_t> rangeEnds;
+	refitter.refit(nodes, nodeParents, leafNodes, primitiveBounds(rangeEnds));
+	bvhCostRatio = builtCost > 0.0f ? BVHBuilder::sahCost(nodes) / builtCost : 1.0f;
+	return bvhCostRatio;
+}
+
+void Scene::applyBVH(const std::vector<BVHNode>& builtNodes, const std::vector<uint32_t>& order)
+{
+	dropCache();
+	nodes = builtNodes;
+	nodeParents.clear();
+	leafNodes.clear();
+	bvhCostRatio = 1.0f;
+
+	uint32_t spheresCount = getSpheresCount();
+	uint32_t trianglesEnd = spheresCount + getTrianglesCount();
+	std::vector<uint32_t> sphereOrder(order.begin(), order.begin() + spheresCount);
+	std::vector<uint32_t> triangleOrder(order.begin() + spheresCount, order.begin() + trianglesEnd);
+	std::vector<uint32_t> instanceOrder(order.begin() + trianglesEnd, order.end());
+	for (uint32_t& idx : triangleOrder)
+		idx -= spheresCount;
+	for (uint32_t& idx : instanceOrder)
+		idx -= trianglesEnd;
+
+	reorder(centers, sphereOrder);
+	reorder(radii, sphereOrder);
+	reorder(materialIds, sphereOrder);
+	reorder(sphereIds, sphereOrder);
+	for (uint32_t i = 0; i < getSpheresCount(); i++)
+		sphereSlots[sphereIds[i]] = i;
+	reorder(triangles, triangleOrder);
+	reorder(triangleMaterialIds, triangleOrder);
+	reorder(instances, instanceOrder);
+	reorder(instanceIds, instanceOrder);
+	for (uint32_t i = 0; i < getInstancesCount(); i++)
+		instanceSlots[instanceIds[i]] = i;
+}
+
+template<typename Visitor>
+void Scene::visitSections(Visitor visit)
+{
+	visit(nodes, &deviceNodes);
+	visit(centers, &deviceCenters);
+	visit(radii, &deviceRadii);
+	visit(materialIds, &deviceMaterialIds);
+	visit(vertices, &deviceVertices);
+	visit(normals, &deviceNormals);
+	visit(triangles, &deviceTriangles);
+	visit(triangleMaterialIds, &deviceTriangleMaterialIds);
+	visit(geometries, &deviceGeometries);
+	visit(geometryNodes, &deviceGeometryNodes);
+	visit(geometryTriangles, &deviceGeometryTriangles);
+	visit(instances, &deviceInstances);
+	visit(materials, &deviceMaterials);
+
+	visit(sphereIds, static_cast<uint32_t**>(nullptr));
+	visit(sphereSlots, static_cast<uint32_t**>(nullptr));
+	visit(instanceIds, static_cast<uint32_t**>(nullptr));
+	visit(instanceSlots, static_cast<uint32_t**>(nullptr));
+}
+
+size_t Scene::layoutSections(std::vector<size_t>& offsets, size_t& deviceImageSize)
+{
+	offsets.clear();
+	size_t size = 0;
+	bool deviceSections = true;
+	visitSections([&](auto& data, auto** devicePointer) {
+		if (deviceSections && !devicePointer) {
+			deviceSections = false;
+			deviceImageSize = alignOffset(size);
+		}
+		offsets.push_back(reserveSection(size, data));
+	});
+	return alignOffset(size);
+}
+
+bool Scene::indicesInRange() const
+{
+	auto below = [](uint32_t index, size_t limit) { return index < limit; };
+	auto triangleBelow = [](const glm::u32vec3& triangle, size_t limit) {
+		return triangle.x < limit && triangle.y < limit && triangle.z < limit;
+	};
+	auto instanceBelow = [&](const InstanceData& instance, size_t) {
+		return instance.geometryId < geometries.size() && instance.materialId < materials.size();
+	};
+	auto geometryBelow = [&](const MeshGeometry& geometry, size_t) {
+		return geometry.firstNode <= geometryNodes.size() && geometry.nodesCount <= geometryNodes.size() - geometry.firstNode
+			&& geometry.firstTriangle <= geometryTriangles.size()
+			&& geometry.trianglesCount <= geometryTriangles.size() - geometry.firstTriangle
+			&& validTree(geometryNodes.data() + geometry.firstNode, geometry.nodesCount, geometry.trianglesCount);
+	};
+
+	size_t primitivesCount = centers.size() + triangles.size() + instances.size();
+	return indicesBelow(triangles, vertices.size(), triangleBelow) && indicesBelow(geometryTriangles, vertices.size(), triangleBelow)
+		&& indicesBelow(materialIds, materials.size(), below) && indicesBelow(triangleMaterialIds, materials.size(), below)
+		&& indicesBelow(sphereIds, centers.size(), below) && indicesBelow(sphereSlots, centers.size(), below)
+		&& indicesBelow(instanceIds, instances.size(), below) && indicesBelow(instanceSlots, instances.size(), below)
+		&& indicesBelow(instances, 0, instanceBelow) && indicesBelow(geometries, 0, geometryBelow)
+		&& validTree(nodes.data(), nodes.size(), primitivesCount);
+}
+
+void Scene::dropCache()
+{
+	cache.reset();
+	cacheImageOffset = 0;
+}
+
+void Scene::upload()
+{
+	freeDevice();
+
+	if (nodes.empty()) {
+		BVHBuilder builder;
+		buildBVH(builder);
+	}
+
+	std::vector<size_t> offsets;
+	layoutSections(offsets, deviceBufferSize);
+	checkCudaErrors(cudaMalloc((void**)&deviceBuffer, deviceBufferSize));
+
+	if (cache) {
+		//Loaded sections sit where layoutSections puts them, the mapped image is a ready staging buffer
+		checkCudaErrors(cudaMemcpy(deviceBuffer, cache->data() + cacheImageOffset, deviceBufferSize, cudaMemcpyHostToDevice));
+	}
+	else {
+		std::vector<unsigned char> staging(deviceBufferSize);
+		size_t section = 0;
+		visitSections([&](auto& data, auto** devicePointer) {
+			if (devicePointer)
+				copySection(staging, offsets[section], data);
+			section++;
+		});
+		checkCudaErrors(cudaMemcpy(deviceBuffer, staging.data(), deviceBufferSize, cudaMemcpyHostToDevice));
+	}
+
+	size_t section = 0;
+	visitSections([&](auto& data, auto** devicePointer) {
+		using Element = typename std::decay_t<decltype(data)>::value_type;
+		if (devicePointer)
+			*devicePointer = data.empty() ? nullptr : reinterpret_cast<Element*>(deviceBuffer + offsets[section]);
+		section++;
+	});
+}
+
+void Scene::freeDevice()
+{
+	if (deviceBuffer)
+		checkCudaErrors(cudaFree(deviceBuffer));
+
+	deviceBuffer = nullptr;
+	deviceBufferSize = 0;
+	visitSections([](auto&, auto** devicePointer) {
+		if (devicePointer)
+			*devicePointer = nullptr;
+	});
+}
+
+bool Scene::saveCache(const std::string& path, uint64_t key)
+{
+	//Rewriting the mapped file would pull it from under the mapping
+	dropCache();
+	if (nodes.empty()) {
+		BVHBuilder builder;
+		buildBVH(builder);
+	}
+
+	std::vector<size_t> offsets;
+	size_t deviceImageSize = 0;
+	size_t imageSize = layoutSections(offsets, deviceImageSize);
+
+	CacheHeader header = {};
+	memcpy(header.magic, cacheMagic, sizeof(header.magic));
+	header.version = cacheVersion;
+	header.sectionsCount = static_cast<uint32_t>(offsets.size());
+	header.key = key;
+	header.deviceImageSize = deviceImageSize;
+	header.imageSize = imageSize;
+
+	std::vector<CacheSection> table;
+	header.checksum = cacheChecksumSeed;
+	visitSections([&](auto& data, auto**) {
+		CacheSection entry = {};
+		entry.offset = offsets[table.size()];
+		entry.count = data.size();
+		entry.elementSize = sizeof(typename std::decay_t<decltype(data)>::value_type);
+		table.push_back(entry);
+		header.checksum = cacheChecksum(reinterpret_cast<const unsigned char*>(data.data()), entry.count * entry.elementSize,
+			header.checksum);
+	});
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(CacheSection));
+
+	//Gaps are zero filled, the image goes to disk exactly as it goes to the device
+	size_t imageStart = cacheImageStart(table.size());
+	size_t written = sizeof(header) + table.size() * sizeof(CacheSection);
+	std::vector<char> zeros(bufferAlignment, 0);
+	auto padTo = [&](size_t position) {
+		file.write(zeros.data(), position - written);
+		written = position;
+	};
+	padTo(imageStart);
+
+	size_t section = 0;
+	visitSections([&](auto& data, auto**) {
+		padTo(imageStart + offsets[section++]);
+		size_t bytes = data.size() * sizeof(typename std::decay_t<decltype(data)>::value_type);
+		if (bytes > 0)
+			file.write(reinterpret_cast<const char*>(data.data()), bytes);
+		written += bytes;
+	});
+	padTo(imageStart + imageSize);
+
+	file.close();
+	if (!file) {
+		std::remove(path.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool Scene::loadCache(const std::string& path, uint64_t key)
+{
+	std::unique_ptr<MappedFile> file(new MappedFile());
+	if (!file->open(path) || file->size() < sizeof(CacheHeader))
+		return false;
+
+	size_t sectionsCount = 0;
+	visitSections([&](auto&, auto**) { sectionsCount++; });
+
+	CacheHeader header;
+	memcpy(&header, file->data(), sizeof(header));
+	if (memcmp(header.magic, cacheMagic, sizeof(header.magic)) != 0 || header.version != cacheVersion || header.key != key
+		|| header.sectionsCount != sectionsCount)
+		return false;
+
+	size_t imageStart = cacheImageStart(sectionsCount);
+	if (file->size() < imageStart || header.imageSize > file->size() - imageStart || header.deviceImageSize > header.imageSize)
+		return false;
+
+	std::vector<CacheSection> table(sectionsCount);
+	memcpy(table.data(), file->data() + sizeof(CacheHeader), sectionsCount * sizeof(CacheSection));
+
+	//Every section has to lie inside the image before anything is read
+	bool valid = true;
+	size_t section = 0;
+	visitSections([&](auto& data, auto**) {
+		size_t elementSize = sizeof(typename std::decay_t<decltype(data)>::value_type);
+		const CacheSection& entry = table[section++];
+		valid &= entry.elementSize == elementSize && entry.offset <= header.imageSize
+			&& entry.count <= (header.imageSize - entry.offset) / elementSize;
+	});
+	if (!valid)
+		return false;
+
+	const unsigned char* image = file->data() + imageStart;
+	uint64_t checksum = cacheChecksumSeed;
+	for (const CacheSection& entry : table)
+		checksum = cacheChecksum(image + entry.offset, entry.count * entry.elementSize, checksum);
+	if (checksum != header.checksum)
+		return false;
+
+	freeDevice();
+	dropCache();
+	section = 0;
+	visitSections([&](auto& data, auto**) {
+		using Element = typename std::decay_t<decltype(data)>::value_type;
+		const CacheSection& entry = table[section++];
+		const Element* first = reinterpret_cast<const Element*>(image + entry.offset);
+		data.assign(first, first + entry.count);
+	});
+	nodeParents.clear();
+	leafNodes.clear();
+	builtCost = 0.0f;
+	bvhCostRatio = 1.0f;
+
+	uint32_t spheresCount = getSpheresCount(), instancesCount = getInstancesCount();
+	if (nodes.empty() || radii.size() != spheresCount || materialIds.size() != spheresCount || sphereIds.size() != spheresCount
+		|| sphereSlots.size() != spheresCount || (!normals.empty() && normals.size() != vertices.size())
+		|| triangleMaterialIds.size() != triangles.size() || instanceIds.size() != instancesCount || instanceSlots.size() != instancesCount
+		|| !indicesInRange()) {
+		visitSections([](auto& data, auto**) { data.clear(); });
+		return false;
+	}
+
+	//Written by another layout the arrays are still right, only the straight upload from the file is off
+	std::vector<size_t> offsets;
+	size_t deviceImageSize = 0;
+	size_t imageSize = layoutSections(offsets, deviceImageSize);
+	bool sameLayout = deviceImageSize == header.deviceImageSize && imageSize == header.imageSize;
+	for (size_t i = 0; i < sectionsCount; i++)
+		sameLayout &= offsets[i] == table[i].offset;
+	if (sameLayout) {
+		cache = std::move(file);
+		cacheImageOffset = imageStart;
+	}
+	return true;
+}
+
+ScenePrimitives Scene::getHostPrimitives(Material** materialsTable) const
+{
+	ScenePrimitives primitives;
+	primitives.spheres = getHostSpheres(materialsTable);
+	primitives.triangles = getHostTriangles(materialsTable);
+	primitives.instances = getHostInstances(materialsTable);
+	return primitives;
+}
+
+ScenePrimitives Scene::getDevicePrimitives(Material** materialsTable) const
+{
+	ScenePrimitives primitives;
+	primitives.spheres = getDeviceSpheres(materialsTable);
+	primitives.triangles = getDeviceTriangles(materialsTable);
+	primitives.instances = getDeviceInstances(materialsTable);
+	return primitives;
+}
+
+SphereSet Scene::getHostSpheres(Material** materialsTable) const
+{
+	SphereSet set;
+	set.centers = centers.data();
+	set.radii = radii.data();
+	set.materialIds = materialIds.data();
+	set.materials = materialsTable;
+	set.count = getSpheresCount();
+	return set;
+}
+
+SphereSet Scene::getDeviceSpheres(Material** materialsTable) const
+{
+	SphereSet set;
+	set.centers = deviceCenters;
+	set.radii = deviceRadii;
+	set.materialIds = deviceMaterialIds;
+	set.materials = materialsTable;
+	set.count = getSpheresCount();
+	return set;
+}
+
+TriangleSet Scene::getHostTriangles(Material** materialsTable) const
+{
+	TriangleSet set;
+	set.vertices = vertices.data();
+	set.normals = normals.empty() ? nullptr : normals.data();
+	set.indices = triangles.data();
+	set.materialIds = triangleMaterialIds.data();
+	set.materials = materialsTable;
+	set.count = getTrianglesCount();
+	return set;
+}
+
+TriangleSet Scene::getDeviceTriangles(Material** materialsTable) const
+{
+	TriangleSet set;
+	set.vertices = deviceVertices;
+	set.normals = deviceNormals;
+	set.indices = deviceTriangles;
+	set.materialIds = deviceTriangleMaterialIds;
+	set.materials = materialsTable;
+	set.count = getTrianglesCount();
+	return set;
+}
+
+InstanceSet Scene::getHostInstances(Material** materialsTable) const
+{
+	InstanceSet set;
+	set.instances = instances.data();
+	set.geometries = geometries.data();
+	set.nodes = geometryNodes.data();
+	set.vertices = vertices.data();
+	set.normals = normals.empty() ? nullptr : normals.data();
+	set.indices = geometryTriangles.data();
+	set.materials = materialsTable;
+	set.count = getInstancesCount();
+	return set;
+}
+
+InstanceSet Scene::getDeviceInstances(Material** materialsTable) const
+{
+	InstanceSet set;
+	set.instances = deviceInstances;
+	set.geometries = deviceGeometries;
+	set.nodes = deviceGeometryNodes;
+	set.vertices = deviceVertices;
+	set.normals = deviceNormals;
+	set.indices = deviceGeometryTriangles;
+	set.materials = materialsTable;
+	set.count = getInstancesCount();
+	return set;
+}
+
+MaterialTable Scene::getHostMaterialTable() const
+{
+	MaterialTable table;
+	table.materials = materials.data();
+	table.count = getMaterialsCount();
+	return table;
+}
+
+MaterialTable Scene::getDeviceMaterialTable() const
+{
+	MaterialTable table;
+	table.materials = deviceMaterials;
+	table.count = getMaterialsCount();
+	return table;
+}
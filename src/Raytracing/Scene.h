@@ -0,0 +1,160 @@
+#pragma once
+#include "Objects/ScenePrimitives.h"
+#include "Objects/TriangleMesh.h"
+#include "Materials/MaterialTable.h"
+#include "Acceleration/BVHBuilder.h"
+#include "Acceleration/LBVHBuilder.h"
+#include "Acceleration/BVHRefitter.h"
+#include "../Utils/MappedFile.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+//Host built flat scene. Everything lives in plain arrays, upload() packs them
+//into one device buffer with a single copy
+class Scene
+{
+public:
+	Scene() = default;
+	~Scene();
+
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+
+	uint32_t addMaterial(const MaterialData& material);
+	//Returns the id setSphereCenter takes, it stays valid when buildBVH reorders spheres
+	uint32_t addSphere(const glm::vec3& center, float radius, uint32_t materialId);
+	//Moved spheres need updateBVH (or refitBVH / buildBVH) before the next upload
+	void setSphereCenter(uint32_t sphereId, const glm::vec3& center);
+	inline glm::vec3 getSphereCenter(uint32_t sphereId) const { return centers[sphereSlots[sphereId]]; }
+	//Copies the mesh into the shared vertex and index arrays, every triangle gets materialId
+	void addMesh(const TriangleMesh& mesh, uint32_t materialId);
+	//Stores the mesh once for any number of instances: vertices go to the shared arrays, triangles get a bottom level
+	//BVH of their own right away. Returns the id addInstance takes
+	uint32_t addGeometry(const TriangleMesh& mesh, BVHBuilder& builder);
+	//Returns the id setInstanceTransform takes, it stays valid when buildBVH reorders instances
+	uint32_t addInstance(uint32_t geometryId, const glm::mat4& objectToWorld, uint32_t materialId);
+	//Moving an instance only needs the top level rebuilt (buildBVH), geometry BVHs stay as they are
+	void setInstanceTransform(uint32_t instanceId, const glm::mat4& objectToWorld);
+
+	//Builds the top level BVH over spheres, triangles and instances and reorders them to the leaf order
+	void buildBVH(BVHBuilder& builder);
+	//Same with a linear BVH, for rebuilds every frame
+	void buildBVH(LBVHBuilder& builder);
+	//Moves the top level bounds to where spheres and instances are now, topology stays. Returns the SAH cost of the
+	//refitted tree over the cost it had when built
+	float refitBVH(BVHRefitter& refitter);
+	//Refits, unless the refitted tree would cost more than maxCostRatio times the built one, then rebuilds.
+	//Returns true when it rebuilt
+	template<typename Builder>
+	bool updateBVH(BVHRefitter& refitter, Builder& builder, float maxCostRatio = 1.5f) {
+		if (!nodes.empty() && refitBVH(refitter) <= maxCostRatio)
+			return false;
+		buildBVH(builder);
+		return true;
+	}
+
+	void upload();
+	void freeDevice();
+
+	//Binary image of every array and the built top level BVH, sections placed the way upload() places them in the
+	//device buffer. key stands for whatever the scene was built from, loadCache only takes a file with the same key
+	bool saveCache(const std::string& path, uint64_t key);
+	//Replaces the scene with the cached one, false for a missing file, another version or key or a checksum mismatch
+	//(the scene stays as it was) and for arrays that don't fit together or index outside each other (the scene is
+	//left empty). The file stays mapped until the scene changes, so upload() copies the device part straight from it
+	bool loadCache(const std::string& path, uint64_t key);
+
+	//Views for BVH<ScenePrimitives>, materials is a table indexed by material id
+	ScenePrimitives getHostPrimitives(Material** materials) const;
+	ScenePrimitives getDevicePrimitives(Material** materials) const;
+	//Spheres alone, in BVH leaf order but without a tree of their own once there are triangles
+	SphereSet getHostSpheres(Material** materials) const;
+	SphereSet getDeviceSpheres(Material** materials) const;
+	TriangleSet getHostTriangles(Material** materials) const;
+	TriangleSet getDeviceTriangles(Material** materials) const;
+	InstanceSet getHostInstances(Material** materials) const;
+	InstanceSet getDeviceInstances(Material** materials) const;
+	MaterialTable getHostMaterialTable() const;
+	MaterialTable getDeviceMaterialTable() const;
+
+	inline uint32_t getSpheresCount() const { return static_cast<uint32_t>(centers.size()); }
+	inline uint32_t getTrianglesCount() const { return static_cast<uint32_t>(triangles.size()); }
+	inline uint32_t getVerticesCount() const { return static_cast<uint32_t>(vertices.size()); }
+	inline uint32_t getGeometriesCount() const { return static_cast<uint32_t>(geometries.size()); }
+	inline uint32_t getInstancesCount() const { return static_cast<uint32_t>(instances.size()); }
+	inline uint32_t getMaterialsCount() const { return static_cast<uint32_t>(materials.size()); }
+	inline int getNodesCount() const { return static_cast<int>(nodes.size()); }
+	//Of the last refitBVH, 1 right after a build
+	inline float getBVHCostRatio() const { return bvhCostRatio; }
+
+	inline const std::vector<MaterialData>& getMaterials() const { return materials; }
+	inline const std::vector<BVHNode>& getNodes() const { return nodes; }
+	inline const std::vector<BVHNode>& getGeometryNodes() const { return geometryNodes; }
+
+	inline const BVHNode* getDeviceNodes() const { return deviceNodes; }
+	inline const MaterialData* getDeviceMaterials() const { return deviceMaterials; }
+	inline size_t getDeviceBufferSize() const { return deviceBufferSize; }
+
+private:
+	//Appends mesh vertices and normals, returns index of the first one
+	uint32_t addVertices(const TriangleMesh& mesh);
+	//Bounds of every top level primitive in ScenePrimitives order, kind ranges end at rangeEnds
+	std::vector<AABB> primitiveBounds(std::vector<uint32_t>& rangeEnds) const;
+	//Takes the built tree and reorders primitives to its leaf order
+	void applyBVH(const std::vector<BVHNode>& builtNodes, const std::vector<uint32_t>& order);
+	//Calls visit(std::vector<T>&, T** devicePointer) for every array: device ones in buffer order, then host only
+	//ones with a null devicePointer. Upload and the cache both go through it, so they can't disagree on layout
+	template<typename Visitor>
+	void visitSections(Visitor visit);
+	//Offset of every section in visitSections order, returns the size with host only sections
+	size_t layoutSections(std::vector<size_t>& offsets, size_t& deviceImageSize);
+	//Every stored index points inside the array it indexes and both BVH levels are trees traversal can walk
+	bool indicesInRange() const;
+	//Any change makes the mapped cache stale
+	void dropCache();
+
+	std::vector<glm::vec3> centers;
+	std::vector<float> radii;
+	std::vector<uint32_t> materialIds;
+	std::vector<uint32_t> sphereIds; //Id of every sphere in its current place
+	std::vector<uint32_t> sphereSlots; //Current place of every sphere id
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec3> normals; //Empty when no mesh has vertex normals, otherwise one per vertex
+	std::vector<glm::u32vec3> triangles;
+	std::vector<uint32_t> triangleMaterialIds;
+	std::vector<MeshGeometry> geometries;
+	std::vector<BVHNode> geometryNodes;
+	std::vector<glm::u32vec3> geometryTriangles;
+	std::vector<InstanceData> instances;
+	std::vector<uint32_t> instanceIds; //Id of every instance in its current place
+	std::vector<uint32_t> instanceSlots; //Current place of every instance id
+	std::vector<MaterialData> materials;
+	std::vector<BVHNode> nodes;
+	//Refit state of nodes, linked on the first refit after a build
+	std::vector<uint32_t> nodeParents;
+	std::vector<uint32_t> leafNodes;
+	float builtCost = 0.0f;
+	float bvhCostRatio = 1.0f;
+
+	//Mapped by loadCache, the device image starts at cacheImageOffset
+	std::unique_ptr<MappedFile> cache;
+	size_t cacheImageOffset = 0;
+
+	//All device pointers below point into deviceBuffer
+	unsigned char* deviceBuffer = nullptr;
+	size_t deviceBufferSize = 0;
+	BVHNode* deviceNodes = nullptr;
+	glm::vec3* deviceCenters = nullptr;
+	float* deviceRadii = nullptr;
+	uint32_t* deviceMaterialIds = nullptr;
+	glm::vec3* deviceVertices = nullptr;
+	glm::vec3* deviceNormals = nullptr;
+	glm::u32vec3* deviceTriangles = nullptr;
+	uint32_t* deviceTriangleMaterialIds = nullptr;
+	MeshGeometry* deviceGeometries = nullptr;
+	BVHNode* deviceGeometryNodes = nullptr;
+	glm::u32vec3* deviceGeometryTriangles = nullptr;
+	InstanceData* deviceInstances = nullptr;
+	MaterialData* deviceMaterials = nullptr;
+};
@@ -0,0 +1,84 @@
+#include "pch.h"
+#include "PixelBufferRing.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+
+#include "Renderer.h"
+
+namespace {
+	void waitAndDelete(void*& fence)
+	{
+		if (!fence)
+			return;
+
+		GLsync sync = static_cast<GLsync>(fence);
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		while (glClientWaitSync(sync, flags, 1000000000ull) == GL_TIMEOUT_EXPIRED)
+			flags = 0;
+		glDeleteSync(sync);
+		fence = nullptr;
+	}
+}
+
+PixelBufferRing::PixelBufferRing(int32_t width, int32_t height, uint32_t bytesPerPixel, uint32_t buffersCount)
+	: buffers(std::max(buffersCount, 1u)), size(size_t(width) * height * bytesPerPixel), persistent(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+{
+	const GLbitfield persistentFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	for (Buffer& buffer : buffers) {
+		GLCall(glGenBuffers(1, &buffer.rendererId));
+		GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.rendererId));
+		if (persistent) {
+			GLCall(glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, persistentFlags));
+			//Null on failure, map() hands that on and the caller uploads without this buffer
+			buffer.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, persistentFlags);
+		}
+		else {
+			GLCall(glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW));
+		}
+	}
+	GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+}
+
+PixelBufferRing::~PixelBufferRing()
+{
+	for (Buffer& buffer : buffers) {
+		waitAndDelete(buffer.fence);
+		if (buffer.mapped) {
+			GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.rendererId));
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		GLCall(glDeleteBuffers(1, &buffer.rendererId));
+	}
+	GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+}
+
+void* PixelBufferRing::map()
+{
+	Buffer& buffer = buffers[current];
+	waitAndDelete(buffer.fence);
+
+	if (!persistent && !buffer.mapped) {
+		GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.rendererId));
+		buffer.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+	}
+	return buffer.mapped;
+}
+
+void PixelBufferRing::upload(Texture& texture)
+{
+	Buffer& buffer = buffers[current];
+	GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.rendererId));
+	if (!persistent) {
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		buffer.mapped = nullptr;
+	}
+
+	//With an unpack buffer bound the pointer is an offset into it
+	texture.updateData(nullptr);
+	buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	GLCall(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+
+	current = (current + 1) % buffers.size();
+}
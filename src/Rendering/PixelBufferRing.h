@@ -0,0 +1,35 @@
+#pragma once
+#include "Texture.h"
+#include <vector>
+
+//Pixel unpack buffers the texture is streamed through. The renderer writes frame N + 1 into one buffer while
+//the driver still copies frame N out of another, a fence per buffer makes sure the copy is done before the
+//buffer is written again. With GL 4.4 / ARB_buffer_storage the buffers stay mapped for their whole life,
+//otherwise they are mapped every frame without synchronization, which the fences make safe just the same
+class PixelBufferRing
+{
+public:
+	PixelBufferRing(int32_t width, int32_t height, uint32_t bytesPerPixel, uint32_t buffersCount = 3);
+	~PixelBufferRing();
+
+	//Memory for the next frame, only waits when the GPU is still reading what it held buffersCount frames ago.
+	//Null when the driver can't map the buffer, the frame has to go up some other way then
+	void* map();
+	//Starts the copy of the mapped frame into texture (same size) and returns without waiting for it, only after
+	//map() returned memory
+	void upload(Texture& texture);
+
+	inline bool isPersistent() const { return persistent; }
+
+private:
+	struct Buffer {
+		uint32_t rendererId = 0;
+		void* mapped = nullptr;
+		void* fence = nullptr; //GLsync of the last upload from this buffer
+	};
+
+	std::vector<Buffer> buffers;
+	uint32_t current = 0;
+	size_t size;
+	bool persistent;
+};
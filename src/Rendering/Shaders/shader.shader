@@ -17,9 +17,28 @@ out vec4 FragColor;
 
 in vec2 TexCoord;
 
+//Accumulation buffer of the renderer: rgb - sum of samples, a - their count
 uniform sampler2D texture1;
+uniform float exposure; //Stops, the radiance is scaled by 2^exposure
+uniform int toneMapping; //0 - clamp, 1 - Reinhard, 2 - ACES
+
+//Narkowicz's fit of the ACES filmic curve
+vec3 aces(vec3 x)
+{
+	return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
 
 void main()
 {
-	FragColor = texture(texture1, TexCoord);
+	vec4 accumulation = texture(texture1, TexCoord);
+	vec3 radiance = accumulation.a > 0.0 ? accumulation.rgb / accumulation.a : vec3(0.0);
+	radiance *= exp2(exposure);
+
+	if (toneMapping == 1)
+		radiance = radiance / (1.0 + radiance);
+	else if (toneMapping == 2)
+		radiance = aces(radiance);
+
+	//Same gamma 2 as Camera::convertColor, so clamp at exposure 0 looks like the images the renderer writes
+	FragColor = vec4(sqrt(clamp(radiance, 0.0, 1.0)), 1.0);
 }
\ No newline at end of file
@@ -7,7 +7,7 @@
 #include "Renderer.h"
 
 Texture::Texture(const std::string& path)
-	: texturePath(path), texID(0), textureBuffer(nullptr), width(0), height(0), numOfChannels(0)
+	: texturePath(path), texID(0), textureBuffer(nullptr), width(0), height(0), numOfChannels(0), dataType(GL_UNSIGNED_BYTE)
 {
 	stbi_set_flip_vertically_on_load(true);
 	textureBuffer = stbi_load(texturePath.c_str(), &width, &height, &numOfChannels, 4);
@@ -32,7 +32,7 @@ Texture::Texture(const std::string& path)
 }
 
 Texture::Texture(unsigned char* _textureBuffer, int32_t _width, int32_t _height)
-	: texturePath(""), texID(0), textureBuffer(nullptr), width(_width), height(_height), numOfChannels(4)
+	: texturePath(""), texID(0), textureBuffer(nullptr), width(_width), height(_height), numOfChannels(4), dataType(GL_UNSIGNED_BYTE)
 {
 	GLCall(glGenTextures(1, &texID));
 	GLCall(glBindTexture(GL_TEXTURE_2D, texID));
@@ -42,16 +42,34 @@ Texture::Texture(unsigned char* _textureBuffer, int32_t _width, int32_t _height)
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
 
+	//Drawn over the whole window and replaced every progressive frame, one level is all it ever uses
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
 	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, _textureBuffer));
-	glGenerateMipmap(GL_TEXTURE_2D);
 
 	unbind();
 }
 
-void Texture::updateData(unsigned char* textureBuffer)
+Texture::Texture(const float* _textureBuffer, int32_t _width, int32_t _height)
+	: texturePath(""), texID(0), textureBuffer(nullptr), width(_width), height(_height), numOfChannels(4), dataType(GL_FLOAT)
+{
+	GLCall(glGenTextures(1, &texID));
+	GLCall(glBindTexture(GL_TEXTURE_2D, texID));
+
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
+	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, _textureBuffer));
+
+	unbind();
+}
+
+void Texture::updateData(const void* textureBuffer)
 {
 	glBindTexture(GL_TEXTURE_2D, texID);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, textureBuffer);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, dataType, textureBuffer);
 }
 
 Texture::~Texture()
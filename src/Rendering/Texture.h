@@ -6,12 +6,15 @@ class Texture
 public:
 	Texture(const std::string& path);
 	Texture(unsigned char* textureBuffer, int32_t _width, int32_t _height);
+	//RGBA32F, 4 floats per pixel
+	Texture(const float* textureBuffer, int32_t _width, int32_t _height);
 	~Texture();
 
 	void bind(uint32_t slot = 0) const;
 	void unbind() const;
 
-	void updateData(unsigned char* textureBuffer);
+	//Whole image in the format the texture was created with, textureBuffer is an offset when a pixel unpack buffer is bound
+	void updateData(const void* textureBuffer);
 
 	inline int getWidth() const { return width; }
 	inline int getHeight() const { return height; }
@@ -24,4 +27,5 @@ private:
 
 	unsigned char* textureBuffer;
 	int width, height, numOfChannels;
+	uint32_t dataType; //GL type of updateData pixels
 };
\ No newline at end of file
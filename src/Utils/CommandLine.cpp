@@ -0,0 +1,137 @@
+#include "pch.h"
+#include "CommandLine.h"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+	bool parseInt(const char* text, long long minValue, long long& value)
+	{
+		char* end = nullptr;
+		value = std::strtoll(text, &end, 10);
+		return end != text && *end == '\0' && value >= minValue;
+	}
+
+	bool parseFloat(const char* text, float minValue, float& value)
+	{
+		char* end = nullptr;
+		value = std::strtof(text, &end);
+		return end != text && *end == '\0' && value >= minValue;
+	}
+}
+
+void printUsage(const char* program)
+{
+	std::cout << "Usage: " << program << " [options]\n"
+		<< "  --headless          render once without a window and write --output\n"
+		<< "  --benchmark         time intersection and scattering on host and exit\n"
+		<< "  --bench-rays N      rays per benchmark (default 65536)\n"
+		<< "  --width N           image width (default 1920)\n"
+		<< "  --height N          image height (default 1080)\n"
+		<< "  --spp N             samples per pixel (default 100)\n"
+		<< "  --depth N           max bounces (default 50)\n"
+		<< "  --rr-depth N        Russian roulette after N bounces, 0 - off (default 5)\n"
+		<< "  --adaptive T        spend the spp budget on pixels with relative error above T, 0 - uniform (default 0)\n"
+		<< "  --output PATH       .png, .ppm or .pfm (default render.png)\n"
+		<< "  --mesh PATH         OBJ mesh in place of the middle glass sphere\n"
+		<< "  --instances N       N more copies of --mesh scattered around, geometry stored once (default 0)\n"
+		<< "  --builder NAME      scene BVH builder: sah or lbvh (default sah)\n"
+		<< "  --scene-cache PATH  load the built scene from PATH, or build it and save it there\n"
+		<< "  --backend NAME      auto, cpu or cuda (default auto)\n"
+		<< "  --integrator NAME   megakernel or wavefront (default megakernel)\n"
+		<< "  --sampler NAME      independent or sobol (default independent)\n"
+		<< "  --sort NAME         wavefront shading order: none, material or octant (default none)\n"
+		<< "  --threads N         CPU backend threads, 0 - one per core (default 0)\n"
+		<< "  --help              show this message\n";
+}
+
+bool parseCommandLine(int argc, char** argv, RenderOptions& options)
+{
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h") {
+			printUsage(argv[0]);
+			return false;
+		}
+		if (arg == "--headless") {
+			options.headless = true;
+			continue;
+		}
+		if (arg == "--benchmark") {
+			options.benchmark = true;
+			continue;
+		}
+
+		if (i + 1 >= argc) {
+			std::cout << "Missing value for " << arg << std::endl;
+			printUsage(argv[0]);
+			return false;
+		}
+		const char* value = argv[++i];
+
+		long long number = 0;
+		bool valid = true;
+		if (arg == "--width" || arg == "--height" || arg == "--spp" || arg == "--depth" || arg == "--threads"
+			|| arg == "--bench-rays" || arg == "--rr-depth" || arg == "--instances") {
+			valid = parseInt(value, arg == "--threads" || arg == "--rr-depth" || arg == "--instances" ? 0 : 1, number);
+			if (arg == "--width")
+				options.imageSize.x = static_cast<uint32_t>(number);
+			else if (arg == "--height")
+				options.imageSize.y = static_cast<uint32_t>(number);
+			else if (arg == "--spp")
+				options.samplesPerPixel = static_cast<int>(number);
+			else if (arg == "--depth")
+				options.maxDepth = static_cast<int>(number);
+			else if (arg == "--threads")
+				options.threads = static_cast<uint32_t>(number);
+			else if (arg == "--rr-depth")
+				options.rouletteDepth = static_cast<int>(number);
+			else if (arg == "--instances")
+				options.instances = static_cast<uint32_t>(number);
+			else
+				options.benchmarkRays = static_cast<uint32_t>(number);
+		}
+		else if (arg == "--adaptive")
+			valid = parseFloat(value, 0.0f, options.adaptiveThreshold);
+		else if (arg == "--output" || arg == "-o")
+			options.output = value;
+		else if (arg == "--mesh")
+			options.mesh = value;
+		else if (arg == "--scene-cache")
+			options.sceneCache = value;
+		else if (arg == "--builder") {
+			options.builder = value;
+			valid = options.builder == "sah" || options.builder == "lbvh";
+		}
+		else if (arg == "--backend") {
+			options.backend = value;
+			valid = options.backend == "auto" || options.backend == "cpu" || options.backend == "cuda";
+		}
+		else if (arg == "--integrator") {
+			options.integrator = value;
+			valid = options.integrator == "megakernel" || options.integrator == "wavefront";
+		}
+		else if (arg == "--sampler") {
+			options.sampler = value;
+			valid = options.sampler == "independent" || options.sampler == "sobol";
+		}
+		else if (arg == "--sort") {
+			options.sort = value;
+			valid = options.sort == "none" || options.sort == "material" || options.sort == "octant";
+		}
+		else {
+			std::cout << "Unknown option " << arg << std::endl;
+			printUsage(argv[0]);
+			return false;
+		}
+
+		if (!valid) {
+			std::cout << "Invalid value for " << arg << ": " << value << std::endl;
+			printUsage(argv[0]);
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "glm/glm.hpp"
+
+struct RenderOptions
+{
+	bool headless = false; //No window, render once and write output
+	bool benchmark = false; //Run the host microbenchmarks and exit
+	uint32_t benchmarkRays = 65536;
+	glm::u32vec2 imageSize = glm::u32vec2(1920, 1080);
+	int samplesPerPixel = 100;
+	int maxDepth = 50;
+	int rouletteDepth = 5; //Russian roulette after this many bounces, 0 - off
+	float adaptiveThreshold = 0.0f; //Relative error noisy pixels are sampled down to, same average spp, 0 - uniform
+	std::string output = "render.png";
+	std::string mesh; //OBJ placed in the middle of the scene, empty - spheres only
+	std::string builder = "sah"; //Scene BVH: sah or lbvh (linear, much faster to build, slower to trace)
+	uint32_t instances = 0; //Small copies of mesh scattered over the ground, all sharing one geometry
+	std::string sceneCache; //Built scene with its BVH, loaded when it matches the options above, written otherwise
+	std::string backend = "auto"; //auto, cpu, cuda
+	std::string integrator = "megakernel"; //megakernel, wavefront
+	std::string sampler = "independent"; //independent, sobol
+	std::string sort = "none"; //Wavefront only: none, material, octant (material then direction octant)
+	uint32_t threads = 0; //CPU backend only, 0 - one per core
+};
+
+//Returns false (after printing the reason and usage) when the program should exit
+bool parseCommandLine(int argc, char** argv, RenderOptions& options);
+void printUsage(const char* program);
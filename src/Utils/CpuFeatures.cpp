@@ -0,0 +1,89 @@
+#include "pch.h"
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace
+{
+	struct Features {
+		bool avx2 = false;
+		bool avx512 = false;
+	};
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+	void cpuid(int leaf, int subleaf, int regs[4])
+	{
+#ifdef _MSC_VER
+		__cpuidex(regs, leaf, subleaf);
+#else
+		unsigned int a, b, c, d;
+		__cpuid_count(leaf, subleaf, a, b, c, d);
+		regs[0] = int(a);
+		regs[1] = int(b);
+		regs[2] = int(c);
+		regs[3] = int(d);
+#endif
+	}
+
+	unsigned long long readXCR0()
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned int low, high;
+		__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return (unsigned long long)high << 32 | low;
+#endif
+	}
+
+	Features detect()
+	{
+		Features features;
+		int regs[4];
+		cpuid(0, 0, regs);
+		if (regs[0] < 7)
+			return features;
+
+		//The OS has to save the wider registers on context switches too, OSXSAVE says XCR0 can be asked
+		cpuid(1, 0, regs);
+		bool osxsave = (regs[2] & (1 << 27)) != 0;
+		bool avx = (regs[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx)
+			return features;
+
+		unsigned long long xcr0 = readXCR0();
+		bool ymmState = (xcr0 & 0x6) == 0x6;
+		bool zmmState = (xcr0 & 0xe6) == 0xe6; //Plus opmask and both halves of the upper registers
+
+		cpuid(7, 0, regs);
+		features.avx2 = ymmState && (regs[1] & (1 << 5)) != 0;
+		features.avx512 = features.avx2 && zmmState && (regs[1] & (1 << 16)) != 0;
+		return features;
+	}
+#else
+	Features detect()
+	{
+		return Features();
+	}
+#endif
+
+	const Features& features()
+	{
+		static const Features detected = detect();
+		return detected;
+	}
+}
+
+bool CpuFeatures::hasAVX2()
+{
+	return features().avx2;
+}
+
+bool CpuFeatures::hasAVX512()
+{
+	return features().avx512;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+//Instruction sets the host CPU and OS both support, checked once on first use
+namespace CpuFeatures
+{
+	bool hasAVX2();
+	//AVX-512 Foundation
+	bool hasAVX512();
+}
@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	uint32_t crcTable[256];
+
+	void initCrcTable()
+	{
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			crcTable[n] = c;
+		}
+	}
+
+	uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+	{
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void pushBigEndian(std::vector<unsigned char>& out, uint32_t value)
+	{
+		out.push_back(value >> 24);
+		out.push_back(value >> 16);
+		out.push_back(value >> 8);
+		out.push_back(value);
+	}
+
+	void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data)
+	{
+		std::vector<unsigned char> chunk;
+		pushBigEndian(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		pushBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+		file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	}
+
+	std::string extension(const std::string& path)
+	{
+		size_t dot = path.find_last_of('.');
+		if (dot == std::string::npos)
+			return "";
+
+		std::string ext = path.substr(dot + 1);
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return ext;
+	}
+}
+
+bool ImageWriter::writePNG(const std::string& path, const unsigned char* rgba, uint32_t width, uint32_t height)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cout << "Failed to open " << path << std::endl;
+		return false;
+	}
+
+	static bool crcReady = false;
+	if (!crcReady) {
+		initCrcTable();
+		crcReady = true;
+	}
+
+	//Filter byte 0 + RGB for every row
+	std::vector<unsigned char> raw;
+	raw.reserve(size_t(height) * (1 + width * 3));
+	for (uint32_t j = 0; j < height; j++) {
+		raw.push_back(0);
+		for (uint32_t i = 0; i < width; i++) {
+			const unsigned char* p = rgba + (size_t(j) * width + i) * 4;
+			raw.insert(raw.end(), p, p + 3);
+		}
+	}
+
+	//zlib stream made of stored deflate blocks (max 65535 bytes each)
+	std::vector<unsigned char> idat = { 0x78, 0x01 };
+	size_t offset = 0;
+	do {
+		uint16_t blockSize = static_cast<uint16_t>(std::min<size_t>(65535, raw.size() - offset));
+		bool last = offset + blockSize == raw.size();
+		idat.push_back(last ? 1 : 0);
+		idat.push_back(blockSize & 0xff);
+		idat.push_back(blockSize >> 8);
+		idat.push_back(~blockSize & 0xff);
+		idat.push_back((~blockSize >> 8) & 0xff);
+		idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+		offset += blockSize;
+	} while (offset < raw.size());
+
+	uint32_t a = 1, b = 0;
+	for (unsigned char c : raw) {
+		a = (a + c) % 65521;
+		b = (b + a) % 65521;
+	}
+	pushBigEndian(idat, (b << 16) | a);
+
+	std::vector<unsigned char> ihdr;
+	pushBigEndian(ihdr, width);
+	pushBigEndian(ihdr, height);
+	ihdr.insert(ihdr.end(), { 8, 2, 0, 0, 0 }); //8 bit, RGB, deflate, no filter, no interlace
+
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+	writeChunk(file, "IHDR", ihdr);
+	writeChunk(file, "IDAT", idat);
+	writeChunk(file, "IEND", {});
+
+	return file.good();
+}
+
+bool ImageWriter::writePPM(const std::string& path, const unsigned char* rgba, uint32_t width, uint32_t height)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cout << "Failed to open " << path << std::endl;
+		return false;
+	}
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+	for (size_t i = 0; i < size_t(width) * height; i++)
+		file.write(reinterpret_cast<const char*>(rgba + i * 4), 3);
+
+	return file.good();
+}
+
+bool ImageWriter::writePFM(const std::string& path, const glm::vec3* radiance, uint32_t width, uint32_t height)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cout << "Failed to open " << path << std::endl;
+		return false;
+	}
+
+	//Negative scale - little endian, rows go bottom to top
+	file << "PF\n" << width << " " << height << "\n-1.0\n";
+	for (uint32_t j = height; j-- > 0;)
+		file.write(reinterpret_cast<const char*>(radiance + size_t(j) * width), width * sizeof(glm::vec3));
+
+	return file.good();
+}
+
+bool ImageWriter::write(const std::string& path, const unsigned char* rgba, const glm::vec3* radiance, uint32_t width, uint32_t height)
+{
+	std::string ext = extension(path);
+	if (ext == "png")
+		return writePNG(path, rgba, width, height);
+	if (ext == "ppm")
+		return writePPM(path, rgba, width, height);
+	if (ext == "pfm")
+		return writePFM(path, radiance, width, height);
+
+	std::cout << "Unknown image format: " << path << " (expected .png, .ppm or .pfm)" << std::endl;
+	return false;
+}
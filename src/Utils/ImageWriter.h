@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "glm/glm.hpp"
+
+//Minimal image output for headless renders, rows are stored top to bottom like the render buffers
+namespace ImageWriter
+{
+	//8 bit RGBA input, alpha is dropped. PNG uses stored (uncompressed) deflate blocks
+	bool writePNG(const std::string& path, const unsigned char* rgba, uint32_t width, uint32_t height);
+	bool writePPM(const std::string& path, const unsigned char* rgba, uint32_t width, uint32_t height);
+
+	//Linear float radiance, no tone mapping
+	bool writePFM(const std::string& path, const glm::vec3* radiance, uint32_t width, uint32_t height);
+
+	//Picks the format from the extension (.png, .ppm, .pfm)
+	bool write(const std::string& path, const unsigned char* rgba, const glm::vec3* radiance, uint32_t width, uint32_t height);
+}
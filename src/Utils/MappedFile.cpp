@@ -0,0 +1,95 @@
+#include "pch.h"
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+	file = fileHandle;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+
+	mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		close();
+		return false;
+	}
+
+	bytes = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!bytes) {
+		close();
+		return false;
+	}
+	length = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes)
+		UnmapViewOfFile(bytes);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+
+	bytes = nullptr;
+	length = 0;
+	mapping = nullptr;
+	file = nullptr;
+}
+#else
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	//The mapping keeps the file referenced, the descriptor isn't needed after this
+	void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED)
+		return false;
+
+	bytes = static_cast<const unsigned char*>(mapped);
+	length = static_cast<size_t>(info.st_size);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes)
+		munmap(const_cast<unsigned char*>(bytes), length);
+
+	bytes = nullptr;
+	length = 0;
+}
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+//Read-only memory mapping of a whole file, pages are loaded by the OS as they are touched
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	//false when the file can't be opened or is empty
+	bool open(const std::string& path);
+	void close();
+
+	inline const unsigned char* data() const { return bytes; }
+	inline size_t size() const { return length; }
+
+private:
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
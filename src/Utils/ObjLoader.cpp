@@ -0,0 +1,277 @@
+#include "pch.h"
+#include "ObjLoader.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	constexpr size_t chunkSize = 1 << 20;
+	constexpr uint32_t noNormal = 0xffffffffu;
+	constexpr uint64_t emptyKey = ~0ull;
+
+	//Output vertex of every (position, normal) pair seen so far, open addressing so faces never allocate
+	class VertexTable
+	{
+	public:
+		VertexTable() : keys(1024, emptyKey), values(1024) {}
+
+		//Index of key in the output, or newIndex after inserting it
+		uint32_t findOrInsert(uint64_t key, uint32_t newIndex, bool& inserted) {
+			if ((used + 1) * 2 > keys.size())
+				grow();
+
+			size_t slot = find(key);
+			inserted = keys[slot] == emptyKey;
+			if (inserted) {
+				keys[slot] = key;
+				values[slot] = newIndex;
+				used++;
+			}
+			return values[slot];
+		}
+
+	private:
+		size_t find(uint64_t key) const {
+			size_t mask = keys.size() - 1;
+			size_t slot = static_cast<size_t>((key * 0x9e3779b97f4a7c15ull) >> 32) & mask;
+			while (keys[slot] != emptyKey && keys[slot] != key)
+				slot = (slot + 1) & mask;
+			return slot;
+		}
+
+		void grow() {
+			std::vector<uint64_t> oldKeys(keys.size() * 2, emptyKey);
+			std::vector<uint32_t> oldValues(values.size() * 2);
+			oldKeys.swap(keys);
+			oldValues.swap(values);
+			for (size_t i = 0; i < oldKeys.size(); i++) {
+				if (oldKeys[i] != emptyKey) {
+					size_t slot = find(oldKeys[i]);
+					keys[slot] = oldKeys[i];
+					values[slot] = oldValues[i];
+				}
+			}
+		}
+
+		std::vector<uint64_t> keys;
+		std::vector<uint32_t> values;
+		size_t used = 0;
+	};
+
+	inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+	inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+	inline void skipSpaces(const char*& p) {
+		while (isSpace(*p))
+			p++;
+	}
+
+	//Plain decimal with optional exponent, independent of the C locale
+	float parseFloat(const char*& p) {
+		skipSpaces(p);
+		bool negative = *p == '-';
+		if (*p == '-' || *p == '+')
+			p++;
+
+		double value = 0.0;
+		while (isDigit(*p))
+			value = value * 10.0 + (*p++ - '0');
+
+		if (*p == '.') {
+			p++;
+			double scale = 0.1;
+			while (isDigit(*p)) {
+				value += (*p++ - '0') * scale;
+				scale *= 0.1;
+			}
+		}
+
+		if (*p == 'e' || *p == 'E') {
+			p++;
+			bool negativeExponent = *p == '-';
+			if (*p == '-' || *p == '+')
+				p++;
+			int exponent = 0;
+			while (isDigit(*p))
+				exponent = exponent * 10 + (*p++ - '0');
+			value *= std::pow(10.0, negativeExponent ? -exponent : exponent);
+		}
+
+		return static_cast<float>(negative ? -value : value);
+	}
+
+	//false when there is no number at p
+	bool parseInt(const char*& p, long long& value) {
+		bool negative = *p == '-';
+		if (*p == '-' || *p == '+')
+			p++;
+		if (!isDigit(*p))
+			return false;
+
+		value = 0;
+		while (isDigit(*p))
+			value = value * 10 + (*p++ - '0');
+		if (negative)
+			value = -value;
+		return true;
+	}
+
+	//OBJ indices start at 1, negative ones count back from the last element defined so far
+	bool resolveIndex(long long index, size_t count, uint32_t& resolved) {
+		long long idx = index < 0 ? static_cast<long long>(count) + index : index - 1;
+		if (index == 0 || idx < 0 || idx >= static_cast<long long>(count))
+			return false;
+		resolved = static_cast<uint32_t>(idx);
+		return true;
+	}
+
+	class Parser
+	{
+	public:
+		Parser(TriangleMesh& mesh) : mesh(mesh) {}
+
+		//line ends at '\n' or '\0'
+		bool parseLine(const char* p) {
+			skipSpaces(p);
+			if (p[0] == 'v' && isSpace(p[1])) {
+				p++;
+				float x = parseFloat(p), y = parseFloat(p), z = parseFloat(p);
+				positions.push_back(glm::vec3(x, y, z));
+			}
+			else if (p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+				p += 2;
+				float x = parseFloat(p), y = parseFloat(p), z = parseFloat(p);
+				fileNormals.push_back(glm::vec3(x, y, z));
+			}
+			else if (p[0] == 'f' && isSpace(p[1]))
+				return parseFace(p + 1);
+
+			return true;
+		}
+
+		void finish() {
+			if (!allCornersHaveNormals || !anyCornerHasNormal)
+				std::vector<glm::vec3>().swap(mesh.normals);
+		}
+
+	private:
+		bool parseFace(const char* p) {
+			uint32_t first = 0, previous = 0;
+			int corners = 0;
+			while (true) {
+				skipSpaces(p);
+				long long index;
+				if (!parseInt(p, index))
+					break;
+
+				uint32_t position, normal = noNormal;
+				if (!resolveIndex(index, positions.size(), position))
+					return false;
+
+				if (*p == '/') {
+					p++;
+					long long ignored;
+					parseInt(p, ignored); //Texture coordinates
+					if (*p == '/') {
+						p++;
+						if (parseInt(p, index) && !resolveIndex(index, fileNormals.size(), normal))
+							return false;
+					}
+				}
+
+				uint32_t vertex = addVertex(position, normal);
+				if (corners == 0)
+					first = vertex;
+				else if (corners >= 2)
+					mesh.indices.push_back(glm::u32vec3(first, previous, vertex));
+				previous = vertex;
+				corners++;
+			}
+			return corners >= 3 || corners == 0;
+		}
+
+		uint32_t addVertex(uint32_t position, uint32_t normal) {
+			bool inserted;
+			uint64_t key = (uint64_t(position) << 32) | normal;
+			uint32_t vertex = table.findOrInsert(key, mesh.getVerticesCount(), inserted);
+			if (inserted) {
+				mesh.vertices.push_back(positions[position]);
+				//Normals only exist once some corner had one, vertices before it get zero normals then
+				if (normal != noNormal) {
+					mesh.normals.resize(mesh.vertices.size() - 1, glm::vec3(0.0f));
+					mesh.normals.push_back(fileNormals[normal]);
+				}
+				else if (!mesh.normals.empty())
+					mesh.normals.push_back(glm::vec3(0.0f));
+			}
+
+			allCornersHaveNormals &= normal != noNormal;
+			anyCornerHasNormal |= normal != noNormal;
+			return vertex;
+		}
+
+		TriangleMesh& mesh;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> fileNormals;
+		VertexTable table;
+		bool allCornersHaveNormals = true;
+		bool anyCornerHasNormal = false;
+	};
+}
+
+bool ObjLoader::load(const std::string& path, TriangleMesh& mesh)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		std::cout << "Failed to open " << path << std::endl;
+		return false;
+	}
+
+	mesh = TriangleMesh();
+	Parser parser(mesh);
+
+	//Whole lines are parsed from the chunk, the unfinished last one moves to the front for the next read
+	std::vector<char> buffer(chunkSize + 1);
+	size_t carried = 0;
+	uint64_t lineNumber = 0;
+	bool endOfFile = false;
+	while (!endOfFile) {
+		if (carried == buffer.size() - 1)
+			buffer.resize(buffer.size() + chunkSize); //Line longer than a chunk
+
+		file.read(buffer.data() + carried, buffer.size() - 1 - carried);
+		size_t size = carried + static_cast<size_t>(file.gcount());
+		endOfFile = !file;
+		buffer[size] = '\0';
+
+		size_t lineStart = 0;
+		while (true) {
+			const char* newLine = static_cast<const char*>(memchr(buffer.data() + lineStart, '\n', size - lineStart));
+			if (!newLine && !endOfFile)
+				break;
+
+			size_t lineEnd = newLine ? newLine - buffer.data() : size;
+			buffer[lineEnd] = '\0';
+			lineNumber++;
+			if (!parser.parseLine(buffer.data() + lineStart)) {
+				std::cout << path << ":" << lineNumber << ": invalid face" << std::endl;
+				mesh = TriangleMesh();
+				return false;
+			}
+
+			lineStart = lineEnd + 1;
+			if (lineStart >= size)
+				break;
+		}
+
+		carried = lineStart < size ? size - lineStart : 0;
+		memmove(buffer.data(), buffer.data() + lineStart, carried);
+	}
+
+	parser.finish();
+	return true;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <string>
+#include "../Raytracing/Objects/TriangleMesh.h"
+
+//Wavefront OBJ geometry. The file is read in fixed size chunks and parsed in place, faces go straight into
+//the mesh arrays. Besides the mesh, loading keeps the file's positions and normals (faces index them) and
+//a vertex lookup table, files without normals never allocate any
+namespace ObjLoader
+{
+	//v, vn and f (v, v/vt, v//vn, v/vt/vn, negative indices, polygons as triangle fans), everything else is skipped.
+	//Vertices with different normals are split, normals are dropped when some faces don't have them
+	bool load(const std::string& path, TriangleMesh& mesh);
+}
@@ -0,0 +1,115 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t _threadsCount)
+	: threadsCount(_threadsCount)
+{
+	if (threadsCount == 0)
+		threadsCount = std::max(1u, std::thread::hardware_concurrency());
+
+	for (uint32_t i = 0; i < threadsCount; i++)
+		queues.push_back(std::make_unique<WorkerQueue>());
+
+	for (uint32_t i = 1; i < threadsCount; i++)
+		workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeCondition.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::parallelFor(uint32_t tasksCount, const std::function<void(uint32_t, uint32_t)>& task)
+{
+	if (tasksCount == 0)
+		return;
+
+	//Contiguous chunks so neighbouring tiles stay on one thread until stealing kicks in
+	uint32_t chunk = (tasksCount + threadsCount - 1) / threadsCount;
+	for (uint32_t w = 0; w < threadsCount; w++) {
+		std::lock_guard<std::mutex> lock(queues[w]->mutex);
+		for (uint32_t t = w * chunk; t < std::min(tasksCount, (w + 1) * chunk); t++)
+			queues[w]->tasks.push_back(t);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		currentTask = &task;
+		generation++;
+	}
+	wakeCondition.notify_all();
+
+	runTasks(0, task);
+
+	//Queues are empty now, wait for tasks other workers already took
+	std::unique_lock<std::mutex> lock(mutex);
+	doneCondition.wait(lock, [this] { return activeWorkers == 0; });
+	currentTask = nullptr;
+}
+
+void ThreadPool::workerLoop(uint32_t workerIdx)
+{
+	uint64_t seenGeneration = 0;
+	while (true) {
+		std::unique_lock<std::mutex> lock(mutex);
+		wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+		if (stopping)
+			return;
+
+		seenGeneration = generation;
+		if (!currentTask)
+			continue;
+
+		const std::function<void(uint32_t, uint32_t)>& task = *currentTask;
+		activeWorkers++;
+		lock.unlock();
+
+		runTasks(workerIdx, task);
+
+		lock.lock();
+		if (--activeWorkers == 0)
+			doneCondition.notify_all();
+	}
+}
+
+void ThreadPool::runTasks(uint32_t workerIdx, const std::function<void(uint32_t, uint32_t)>& task)
+{
+	uint32_t taskIdx;
+	while (popTask(workerIdx, taskIdx))
+		task(taskIdx, workerIdx);
+}
+
+bool ThreadPool::popTask(uint32_t workerIdx, uint32_t& taskIdx)
+{
+	//Own queue from the front, others from the back
+	{
+		WorkerQueue& own = *queues[workerIdx];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			taskIdx = own.tasks.front();
+			own.tasks.pop_front();
+			return true;
+		}
+	}
+
+	for (uint32_t i = 1; i < threadsCount; i++) {
+		WorkerQueue& victim = *queues[(workerIdx + i) % threadsCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			taskIdx = victim.tasks.back();
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Persistent worker threads with one task queue per worker. Idle workers steal from the
+//other queues, so uneven tasks (e.g. image tiles with glass vs sky) still balance out
+class ThreadPool
+{
+public:
+	//0 - one worker per hardware thread, calling thread counts as worker 0
+	explicit ThreadPool(uint32_t threadsCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	//Runs task(taskIdx, workerIdx) for every taskIdx in [0, tasksCount) and blocks until all are done
+	void parallelFor(uint32_t tasksCount, const std::function<void(uint32_t, uint32_t)>& task);
+
+	//Elements per task of the chunked loops below, a multiple of 32 so warp sized groups never straddle two chunks
+	static constexpr uint32_t chunkSize = 4096;
+	static inline uint32_t chunksCount(uint32_t count) { return (count + chunkSize - 1) / chunkSize; }
+
+	//Runs body(chunk, first, last) for the ranges [first, last) of chunkSize elements covering [0, count), one task
+	//each. chunk goes up to chunksCount(count) - 1, for per-chunk scratch
+	template<typename Body>
+	void parallelForChunks(uint32_t count, Body body) {
+		parallelFor(chunksCount(count), [&](uint32_t chunk, uint32_t) {
+			uint32_t first = chunk * chunkSize;
+			body(chunk, first, count - first < chunkSize ? count : first + chunkSize);
+		});
+	}
+
+	//Runs body(idx) for every idx in [0, count), chunked as above
+	template<typename Body>
+	void parallelForEach(uint32_t count, Body body) {
+		parallelForChunks(count, [&](uint32_t, uint32_t first, uint32_t last) {
+			for (uint32_t idx = first; idx < last; idx++)
+				body(idx);
+		});
+	}
+
+	inline uint32_t getThreadsCount() const { return threadsCount; }
+
+private:
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<uint32_t> tasks;
+	};
+
+	void workerLoop(uint32_t workerIdx);
+	void runTasks(uint32_t workerIdx, const std::function<void(uint32_t, uint32_t)>& task);
+	bool popTask(uint32_t workerIdx, uint32_t& taskIdx);
+
+	uint32_t threadsCount;
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+	const std::function<void(uint32_t, uint32_t)>* currentTask = nullptr;
+	uint64_t generation = 0;
+	uint32_t activeWorkers = 0;
+	bool stopping = false;
+};
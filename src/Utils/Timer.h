@@ -0,0 +1,9 @@
+#pragma once
+#include <chrono>
+
+namespace Utils {
+	//Wall clock seconds since start, for the per-stage timings of the host passes
+	inline double secondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
@@ -10,45 +10,163 @@
 #include <cstdlib>
 #include <random>
 #include <ctime>
-#include <curand_kernel.h>
+#include <cstdint>
+
+//Lets the raytracing headers build with a plain host compiler
+#if !defined(__CUDACC__) && !defined(__host__)
+#define __host__
+#define __device__
+#define __global__
+#endif
 
 namespace Utils {
-	__device__ const float infinity = std::numeric_limits<float>::infinity();
-    __device__ const float pi = 3.1415926535897932385;
+	constexpr float infinity = std::numeric_limits<float>::infinity();
+    constexpr float pi = 3.1415926535897932385f;
 
-    __device__ static inline double degToRad(double deg) {
+    __host__ __device__ static inline double degToRad(double deg) {
 		return deg * pi / 180.0;
 	}
 
-    __device__ static float generateRandomNumber(curandState* localRandState) {
-        return curand_uniform(localRandState);
+    //Rec. 709 weights of linear rgb
+    __host__ __device__ static inline float luminance(const glm::vec3& color) {
+        return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+    }
+
+    //Sequence generateRandomNumber draws from, picked per render by the camera
+    enum class Sampler : uint32_t {
+        Independent = 0, //pcg4d hash of (pixel, sample, bounce, counter)
+        Sobol //Owen scrambled Sobol points, every pair of draws at a bounce is its own 2D point set
+    };
+
+    //Stateless counter based RNG. Every random number is a function of (pixel, sample, bounce, counter),
+    //so nothing has to be stored between launches and both backends draw the same sequence
+    struct RandState {
+        uint32_t pixel;
+        uint32_t sample;
+        uint32_t bounce;
+        uint32_t counter;
+        Sampler sampler;
+    };
+
+    //pcg4d (Jarzynski, Olano - Hash Functions for GPU Rendering)
+    __host__ __device__ static inline glm::u32vec4 pcg4d(glm::u32vec4 v) {
+        v = v * 1664525u + 1013904223u;
+        v.x += v.y * v.w; v.y += v.z * v.x; v.z += v.x * v.y; v.w += v.y * v.z;
+        v ^= v >> 16u;
+        v.x += v.y * v.w; v.y += v.z * v.x; v.z += v.x * v.y; v.w += v.y * v.z;
+        return v;
+    }
+
+    //seed changes the whole image (e.g. a different frame), pixel and sample pick the stream
+    __host__ __device__ static inline RandState makeRandState(uint32_t pixel, uint32_t sample, uint32_t seed = 0, Sampler sampler = Sampler::Independent) {
+        RandState ret = { pixel ^ (seed * 0x9e3779b9u), sample, 0, 0, sampler };
+        return ret;
+    }
+
+    //Every bounce starts its own stream so the number of draws at one bounce doesn't shift the next
+    __host__ __device__ static inline void setBounce(uint32_t bounce, RandState* localRandState) {
+        localRandState->bounce = bounce;
+        localRandState->counter = 0;
+    }
+
+    __host__ __device__ static inline uint32_t reverseBits(uint32_t x) {
+#ifdef __CUDA_ARCH__
+        return __brev(x);
+#else
+        x = (x << 16) | (x >> 16);
+        x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+        x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+        x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+        x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+        return x;
+#endif
+    }
+
+    //Owen scrambling of a 0.32 fixed point value as a hash (Burley - Practical Hash-based Owen Scrambling,
+    //with Vegdahl's improved permutation), every seed is a different random scramble
+    __host__ __device__ static inline uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+        x = reverseBits(x);
+        x ^= x * 0x3d20adeau;
+        x += seed;
+        x *= (seed >> 16) | 1u;
+        x ^= x * 0x05526c56u;
+        x ^= x * 0x53a22864u;
+        return reverseBits(x);
     }
 
-    __device__ static float generateRandomNumber(float a, float b, curandState* localRandState) {
+    //Point index of the first two Sobol dimensions as 0.32 fixed point. Dimension 0 is van der Corput,
+    //dimension 1 has direction numbers v(k + 1) = v(k) ^ (v(k) >> 1), so no table is needed
+    __host__ __device__ static inline uint32_t sobol2D(uint32_t index, uint32_t dimension) {
+        if (dimension == 0)
+            return reverseBits(index);
+
+        uint32_t result = 0;
+        for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1) {
+            if (index & 1u)
+                result ^= v;
+        }
+        return result;
+    }
+
+    //Same (0, 1] range as curand_uniform
+    __host__ __device__ static inline float generateRandomNumber(RandState* localRandState) {
+        uint32_t bits;
+        if (localRandState->sampler == Sampler::Sobol) {
+            //Draws 2k and 2k + 1 are one 2D point. Shuffling the index per pixel and pair keeps the pairs
+            //uncorrelated with each other (padding), scrambling the point keeps pixels uncorrelated
+            uint32_t dimension = localRandState->counter & 1u;
+            glm::u32vec4 seeds = pcg4d(glm::u32vec4(localRandState->pixel, localRandState->bounce, localRandState->counter >> 1, 0x50b01u));
+            uint32_t index = nestedUniformScramble(localRandState->sample, seeds.x);
+            bits = nestedUniformScramble(sobol2D(index, dimension), dimension == 0 ? seeds.y : seeds.z);
+            localRandState->counter++;
+        }
+        else {
+            bits = pcg4d(glm::u32vec4(localRandState->pixel, localRandState->sample,
+                localRandState->bounce, localRandState->counter++)).x;
+        }
+        return ((bits >> 8) + 1) * (1.0f / 16777216.0f);
+    }
+
+    __host__ __device__ static inline float generateRandomNumber(float a, float b, RandState* localRandState) {
         // Generowanie i zwracanie losowej liczby
         return a + generateRandomNumber(localRandState) * (b - a);
     }
 
     namespace Vector {
-        __device__ static inline float lenSquared(glm::vec2 vec) {
+        __host__ __device__ static inline float lenSquared(glm::vec2 vec) {
             return vec.x * vec.x + vec.y * vec.y;
         }
         
-        __device__ static inline float lenSquared(glm::vec3 vec) {
+        __host__ __device__ static inline float lenSquared(glm::vec3 vec) {
             return vec.x * vec.x + vec.y * vec.y + vec.z * vec.z;
         }
 
-        __device__ static glm::vec3 randomVector(curandState* localRandState) {
+        __host__ __device__ static glm::vec3 randomVector(RandState* localRandState) {
             return glm::vec3(generateRandomNumber(0.0, 1.0, localRandState), generateRandomNumber(0.0, 1.0, localRandState), 
                 generateRandomNumber(0.0, 1.0, localRandState));
         }
 
-        __device__ static glm::vec3 randomVector(float a, float b, curandState* localRandState) {
+        __host__ __device__ static glm::vec3 randomVector(float a, float b, RandState* localRandState) {
             return glm::vec3(generateRandomNumber(a, b, localRandState), generateRandomNumber(a, b, localRandState),
                 generateRandomNumber(a, b, localRandState));
         }
 
-        __device__ static inline glm::vec3 randomInUnitSphere(curandState* localRandState) {
+        //Uniform direction, z = cos(theta) is uniform in [-1, 1]. Always 2 draws, already unit length
+        __host__ __device__ static inline glm::vec3 randomInUnitSphereVector(RandState* localRandState) {
+            float z = 1.0f - 2.0f * generateRandomNumber(localRandState);
+            float phi = 2.0f * pi * generateRandomNumber(localRandState);
+            float r = sqrtf(fmaxf(0.0f, 1.0f - z * z));
+            return glm::vec3(r * cosf(phi), r * sinf(phi), z);
+        }
+
+        //Uniform point inside the sphere, radius cbrt(u) keeps the density uniform. Always 3 draws
+        __host__ __device__ static inline glm::vec3 randomInUnitSphere(RandState* localRandState) {
+            glm::vec3 direction = randomInUnitSphereVector(localRandState);
+            return cbrtf(generateRandomNumber(localRandState)) * direction;
+        }
+
+        //Old rejection sampler, kept for benchmarks. 3 draws per try, ~1.9 tries on average
+        __host__ __device__ static inline glm::vec3 randomInUnitSphereRejection(RandState* localRandState) {
             while (true) {
                 glm::vec3 randVec = randomVector(-1.0f, 1.0f, localRandState);
                 if (lenSquared(randVec) < 1)
@@ -56,11 +174,16 @@ namespace Utils {
             }
         }
 
-        __device__ static inline glm::vec3 randomInUnitSphereVector(curandState* localRandState) {
-            return glm::normalize(randomInUnitSphere(localRandState));
+        //Tangent and bitangent for a unit normal without branches (Duff et al. - Building an Orthonormal Basis, Revisited)
+        __host__ __device__ static inline void orthonormalBasis(const glm::vec3& n, glm::vec3& tangent, glm::vec3& bitangent) {
+            float sign = copysignf(1.0f, n.z);
+            float a = -1.0f / (sign + n.z);
+            float b = n.x * n.y * a;
+            tangent = glm::vec3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+            bitangent = glm::vec3(b, sign + n.y * n.y * a, -n.y);
         }
 
-        __device__ static inline glm::vec3 randomVectorOnHemisphere(const glm::vec3& normal, curandState* localRandState) {
+        __host__ __device__ static inline glm::vec3 randomVectorOnHemisphere(const glm::vec3& normal, RandState* localRandState) {
             glm::vec3 onUnitSphere = randomInUnitSphereVector(localRandState);
             if (glm::dot(onUnitSphere, normal) > 0.0f)
                 return onUnitSphere;
@@ -68,29 +191,50 @@ namespace Utils {
                 return -onUnitSphere;
         }
 
-        __device__ static inline bool nearZero(const glm::vec3& vector) {
+        __host__ __device__ static inline bool nearZero(const glm::vec3& vector) {
             float s = 1e-8f;
             return (std::fabs(vector.x) < s) && (std::fabs(vector.y) < s) && (std::fabs(vector.z) < s);
         }
 
-        __device__ static inline glm::vec3 reflect(const glm::vec3& v, const glm::vec3& n) {
+        __host__ __device__ static inline glm::vec3 reflect(const glm::vec3& v, const glm::vec3& n) {
             return v - 2 * glm::dot(v, n) * n;
         }
 
-        __device__ static inline glm::vec3 refract(const glm::vec3& uv, const glm::vec3& n, float etaiOverEtat) {
+        __host__ __device__ static inline glm::vec3 refract(const glm::vec3& uv, const glm::vec3& n, float etaiOverEtat) {
             float cosAlpha = std::fmin(glm::dot(-uv, n), 1.0f);
             glm::vec3 outPerpendicular = etaiOverEtat * (uv + cosAlpha * n);
             glm::vec3 outParallel = -sqrt(std::fabs(1.0f - lenSquared(outPerpendicular))) * n;
             return outPerpendicular + outParallel;
         }
 
-        //To samo co randomInUnitSphere ale 2d
-        __device__ static inline glm::vec2 randomInUnitDisk(curandState* localRandState) {
+        //Concentric square to disk mapping (Shirley, Chiu), always 2 draws
+        __host__ __device__ static inline glm::vec2 randomInUnitDisk(RandState* localRandState) {
+            float a = generateRandomNumber(-1.0f, 1.0f, localRandState);
+            float b = generateRandomNumber(-1.0f, 1.0f, localRandState);
+
+            bool horizontal = a * a > b * b;
+            float r = horizontal ? a : b;
+            float phi = horizontal ? (0.25f * pi) * (b / a) : 0.5f * pi - (0.25f * pi) * (a / b);
+            return r == 0.0f ? glm::vec2(0.0f, 0.0f) : r * glm::vec2(cosf(phi), sinf(phi));
+        }
+
+        //Old rejection sampler, kept for benchmarks. 2 draws per try, ~1.27 tries on average
+        __host__ __device__ static inline glm::vec2 randomInUnitDiskRejection(RandState* localRandState) {
             while (true) {
                 glm::vec2 p(generateRandomNumber(-1.0f, 1.0f, localRandState), generateRandomNumber(-1.0f, 1.0f, localRandState));
                 if (lenSquared(p) < 1)
                     return p;
             }
         }
+
+        //Cosine weighted direction around a unit normal, disk point lifted onto the hemisphere (Malley)
+        __host__ __device__ static inline glm::vec3 randomCosineHemisphere(const glm::vec3& normal, RandState* localRandState) {
+            glm::vec2 p = randomInUnitDisk(localRandState);
+            float z = sqrtf(fmaxf(0.0f, 1.0f - lenSquared(p)));
+
+            glm::vec3 tangent, bitangent;
+            orthonormalBasis(normal, tangent, bitangent);
+            return p.x * tangent + p.y * bitangent + z * normal;
+        }
     }
 }
\ No newline at end of file